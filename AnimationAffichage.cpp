@@ -0,0 +1,364 @@
+/*
+ * File:   AnimationAffichage.cpp
+ * Author: olivier
+ */
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "AnimationAffichage.h"
+#include "MoteurLuminosite.h"
+
+static const char magic[8] = "7SEGANI";
+
+AnimationAffichage::AnimationAffichage() {
+    this->projection = nullptr;
+    this->taille = 0;
+    this->entete = nullptr;
+    this->etapes = nullptr;
+    this->tailleEtape = 0;
+}
+
+AnimationAffichage::~AnimationAffichage() {
+    close();
+}
+
+bool AnimationAffichage::open(const string& fichier, string& erreur) {
+    close();
+    int fd = ::open(fichier.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        erreur = "Impossible d'ouvrir " + fichier + " : " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(EnTeteAnimation)) {
+        ::close(fd);
+        erreur = fichier + " n'est pas une animation";
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        erreur = "Impossible de projeter " + fichier + " : " + strerror(errno);
+        return false;
+    }
+    this->projection = (uint8_t*)p;
+    this->taille = st.st_size;
+
+    const EnTeteAnimation* e = (const EnTeteAnimation*)p;
+    if (memcmp(e->magic, magic, sizeof(magic)) != 0 || e->version != version) {
+        close();
+        erreur = fichier + " n'est pas une animation (ou d'une autre version)";
+        return false;
+    }
+    if (e->nbAfficheurs < 1 || e->nbEtapes < 1 || e->reprise >= e->nbEtapes ||
+        e->tailleEtape < sizeof(EtapeAnimation) + e->nbAfficheurs || e->tailleEtape % 8 != 0 ||
+        (this->taille - sizeof(EnTeteAnimation)) / e->tailleEtape < e->nbEtapes) {
+        close();
+        erreur = fichier + " est incomplet ou corrompu";
+        return false;
+    }
+    this->entete = e;
+    this->etapes = this->projection + sizeof(EnTeteAnimation);
+    this->tailleEtape = e->tailleEtape;
+    // Lecture en avant : le noyau lit les pages suivantes par avance et
+    // libère plus volontiers celles déjà lues
+    madvise(this->projection, this->taille, MADV_SEQUENTIAL);
+    return true;
+}
+
+void AnimationAffichage::close() {
+    if (this->projection != nullptr)
+        munmap(this->projection, this->taille);
+    this->projection = nullptr;
+    this->taille = 0;
+    this->entete = nullptr;
+    this->etapes = nullptr;
+    this->tailleEtape = 0;
+}
+
+int AnimationAffichage::getNbAfficheurs() const {
+    return this->entete != nullptr ? this->entete->nbAfficheurs : 0;
+}
+
+size_t AnimationAffichage::size() const {
+    return this->entete != nullptr ? this->entete->nbEtapes : 0;
+}
+
+uint64_t AnimationAffichage::getDuree() const {
+    return this->entete != nullptr ? this->entete->duree : 0;
+}
+
+size_t AnimationAffichage::getReprise() const {
+    return this->entete != nullptr ? this->entete->reprise : 0;
+}
+
+size_t AnimationAffichage::chercher(uint64_t t) const {
+    // Première étape qui commence après 't', la précédente est en cours
+    size_t debut = 0, fin = size();
+    while (debut < fin) {
+        size_t milieu = debut + (fin - debut) / 2;
+        if (etape(milieu).instant <= t)
+            debut = milieu + 1;
+        else
+            fin = milieu;
+    }
+    return debut > 0 ? debut - 1 : 0;
+}
+
+void AnimationAffichage::precharger(size_t i, size_t n) const {
+    if (i >= size())
+        return;
+    n = std::min(n, size() - i);
+    // madvise() attend une adresse alignée sur une page
+    uintptr_t debut = (uintptr_t)(this->etapes + i * this->tailleEtape);
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t aligne = debut & ~(page - 1);
+    madvise((void*)aligne, debut - aligne + n * this->tailleEtape, MADV_WILLNEED);
+}
+
+// Afficheurs occupés par un texte (un '.' partage l'afficheur du caractère
+// qui le précède, voir encoderTexte())
+static int compterAfficheurs(std::string_view text) {
+    int n = 0;
+    bool point = false;
+    for (size_t i = text.size(); i-- > 0; ) {
+        if (text[i] == '.' && !point) {
+            point = true;
+            continue;
+        }
+        n++;
+        point = (text[i] == '.');
+    }
+    return point ? n + 1 : n;
+}
+
+namespace {
+
+// Ecriture des étapes au fil du script : une étape qui ne change ni la
+// trame ni la luminosité prolonge simplement la précédente
+class Compilateur {
+public:
+    Compilateur(ofstream& sortie, int nbAfficheurs, Orientation orientation)
+        : sortie(sortie), trame(nbAfficheurs, 0), derniere(nbAfficheurs, 0) {
+        this->nbAfficheurs = nbAfficheurs;
+        if (orientation == Orientation::DPBas) {
+            this->police = Police7Segments<Orientation::DPBas>::table.data();
+            this->pointDecimal = Police7Segments<Orientation::DPBas>::pointDecimal;
+        }
+        else {
+            this->police = Police7Segments<Orientation::DPHaut>::table.data();
+            this->pointDecimal = Police7Segments<Orientation::DPHaut>::pointDecimal;
+        }
+        this->tailleEtape = (sizeof(EtapeAnimation) + nbAfficheurs + 7) & ~(size_t)7;
+        this->nbEtapes = 0;
+        this->instant = 0;
+        this->luminosite = EtapeAnimation::luminositeLibre;
+        this->fondu = 0;
+        this->luminositeModifiee = false;
+        this->reprise = 0;
+        this->repriseDemandee = false;
+    }
+
+    // Texte dans la trame courante, message d'erreur si impossible
+    string encoder(std::string_view text, uint8_t* octets, int n) {
+        char invalide;
+        switch (encoderTexte(text, this->police, this->pointDecimal, octets, n, invalide)) {
+            case ResultatTexte::CaractereInvalide:
+                return string("Caractère non affichable : ") + invalide;
+            case ResultatTexte::TropLong:
+                return "Texte trop long pour être affiché";
+            default:
+                return "";
+        }
+    }
+
+    void emettre(uint64_t duree) {
+        uint8_t changements = 0;
+        if (this->nbEtapes == 0 || this->trame != this->derniere)
+            changements |= EtapeAnimation::TrameModifiee;
+        if (this->luminositeModifiee)
+            changements |= EtapeAnimation::LuminositeModifiee;
+
+        if (changements != 0 || this->repriseDemandee) {
+            if (this->repriseDemandee)
+                this->reprise = this->nbEtapes;
+            EtapeAnimation e = {this->instant, this->fondu, this->luminosite, changements, 0};
+            vector<char> etape(this->tailleEtape, 0);
+            memcpy(etape.data(), &e, sizeof(e));
+            memcpy(etape.data() + sizeof(e), this->trame.data(), this->nbAfficheurs);
+            this->sortie.write(etape.data(), etape.size());
+            this->nbEtapes++;
+            this->derniere = this->trame;
+            this->luminositeModifiee = false;
+            this->repriseDemandee = false;
+        }
+        this->instant += duree;
+    }
+
+    ofstream& sortie;
+    int nbAfficheurs;
+    const uint16_t* police;
+    uint8_t pointDecimal;
+    size_t tailleEtape;
+    uint32_t nbEtapes;
+    uint64_t instant;
+    vector<uint8_t> trame;          // trame courante
+    vector<uint8_t> derniere;       // trame de la dernière étape écrite
+    uint8_t luminosite;
+    uint32_t fondu;
+    bool luminositeModifiee;
+    uint32_t reprise;
+    bool repriseDemandee;
+};
+
+}
+
+bool AnimationAffichage::compile(istream& script, int nbAfficheurs, Orientation orientation,
+                                 const string& fichier, string& erreur) {
+    if (nbAfficheurs < 1) {
+        erreur = "Le nombre d'afficheur doit être supérieur ou égale à 1";
+        return false;
+    }
+    ofstream sortie(fichier, ios::binary | ios::trunc);
+    if (!sortie) {
+        erreur = "Impossible de créer " + fichier;
+        return false;
+    }
+
+    // En-tête définitif écrit à la fin, quand le nombre d'étapes est connu
+    EnTeteAnimation entete = {};
+    sortie.write((const char*)&entete, sizeof(entete));
+
+    Compilateur c(sortie, nbAfficheurs, orientation);
+    string ligne;
+    int numero = 0;
+    while (getline(script, ligne)) {
+        numero++;
+        istringstream iss(ligne);
+        string commande;
+        if (!(iss >> commande) || commande[0] == '#')
+            continue;
+
+        string probleme;
+        if (commande == "texte") {
+            int64_t duree;
+            string texte;
+            if (!(iss >> duree) || duree < 0)
+                probleme = "Durée attendue";
+            else {
+                getline(iss >> ws, texte);
+                probleme = c.encoder(texte, c.trame.data(), nbAfficheurs);
+                if (probleme.empty())
+                    c.emettre(duree);
+            }
+        }
+        else if (commande == "nombre") {
+            int64_t duree, valeur;
+            if (!(iss >> duree >> valeur) || duree < 0)
+                probleme = "Durée et valeur attendues";
+            else {
+                probleme = c.encoder(to_string(valeur), c.trame.data(), nbAfficheurs);
+                if (probleme.empty())
+                    c.emettre(duree);
+            }
+        }
+        else if (commande == "defilement") {
+            int64_t pas;
+            string texte;
+            if (!(iss >> pas) || pas < 0)
+                probleme = "Durée attendue";
+            else {
+                // Bande : panneau vide, texte, panneau vide. Le texte entre
+                // par la droite et sort par la gauche
+                getline(iss >> ws, texte);
+                int n = compterAfficheurs(texte);
+                vector<uint8_t> bande(2 * nbAfficheurs + n, 0);
+                probleme = c.encoder(texte, bande.data() + nbAfficheurs, n);
+                for (int p = 1; probleme.empty() && p <= nbAfficheurs + n; p++) {
+                    std::copy(bande.begin() + p, bande.begin() + p + nbAfficheurs, c.trame.begin());
+                    c.emettre(pas);
+                }
+            }
+        }
+        else if (commande == "compteur") {
+            int64_t pas, debut, fin, increment = 1;
+            if (!(iss >> pas >> debut >> fin) || pas < 0)
+                probleme = "Durée, début et fin attendus";
+            else {
+                iss >> increment;
+                if (increment == 0 || (fin - debut) / increment < 0)
+                    probleme = "Incrément incompatible avec le début et la fin";
+                for (int64_t v = debut; probleme.empty() && (increment > 0 ? v <= fin : v >= fin); v += increment) {
+                    probleme = c.encoder(to_string(v), c.trame.data(), nbAfficheurs);
+                    if (probleme.empty())
+                        c.emettre(pas);
+                }
+            }
+        }
+        else if (commande == "pause") {
+            int64_t duree;
+            if (!(iss >> duree) || duree < 0)
+                probleme = "Durée attendue";
+            else
+                c.emettre(duree);
+        }
+        else if (commande == "luminosite") {
+            int niveau;
+            int64_t fondu = 0;
+            if (!(iss >> niveau) || niveau < 0 || niveau > MoteurLuminosite::luminositeMax)
+                probleme = "Niveau de luminosité attendu (0 à " + to_string(MoteurLuminosite::luminositeMax) + ")";
+            else {
+                iss >> fondu;
+                c.luminosite = niveau;
+                c.fondu = std::max(fondu, (int64_t)0);
+                c.luminositeModifiee = true;
+            }
+        }
+        else if (commande == "boucle")
+            c.repriseDemandee = true;
+        else
+            probleme = "Commande inconnue : " + commande;
+
+        if (!probleme.empty()) {
+            erreur = "ligne " + to_string(numero) + " : " + probleme;
+            sortie.close();
+            std::remove(fichier.c_str());
+            return false;
+        }
+    }
+
+    // Dernier changement de luminosité ou point de reprise sans étape
+    // derrière : une étape de durée nulle les porte
+    if (c.luminositeModifiee || c.repriseDemandee)
+        c.emettre(0);
+    if (c.nbEtapes == 0) {
+        erreur = "Animation vide";
+        sortie.close();
+        std::remove(fichier.c_str());
+        return false;
+    }
+
+    memcpy(entete.magic, magic, sizeof(magic));
+    entete.version = version;
+    entete.nbAfficheurs = nbAfficheurs;
+    entete.tailleEtape = c.tailleEtape;
+    entete.nbEtapes = c.nbEtapes;
+    entete.duree = c.instant;
+    entete.reprise = c.reprise;
+    sortie.seekp(0);
+    sortie.write((const char*)&entete, sizeof(entete));
+    sortie.close();
+    if (!sortie) {
+        erreur = "Erreur d'écriture dans " + fichier;
+        return false;
+    }
+    return true;
+}
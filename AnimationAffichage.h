@@ -0,0 +1,115 @@
+/*
+ * File:   AnimationAffichage.h
+ * Author: olivier
+ *
+ * Animation précompilée : les défilements, compteurs et boucles d'attente
+ * sont convertis une fois pour toutes (compile(), voir animAfficheur.cpp)
+ * en une suite d'étapes datées contenant chacune la trame déjà encodée et
+ * la luminosité. La lecture (PanneauAffichage::play()) n'a plus rien à
+ * valider ni à encoder : chaque étape envoie directement sa trame depuis
+ * le fichier.
+ *
+ * Le fichier est projeté en mémoire en lecture seule, les pages sont
+ * chargées au fil de la lecture (et annoncées un peu à l'avance) : une
+ * longue animation n'est jamais chargée entièrement. Toutes les étapes ont
+ * la même taille et une date croissante, ce qui permet de se positionner
+ * n'importe où par dichotomie. Le compilateur écrit lui aussi les étapes
+ * au fur et à mesure.
+ *
+ * Le script est une suite de lignes (les lignes vides et celles qui
+ * commencent par '#' sont ignorées), les durées sont en millisecondes :
+ *   texte DUREE TEXTE               texte affiché pendant DUREE
+ *   nombre DUREE VALEUR             entier affiché pendant DUREE
+ *   defilement PAS TEXTE            texte défilant de droite à gauche, PAS par position
+ *   compteur PAS DEBUT FIN [INCR]   entiers de DEBUT à FIN, PAS par valeur
+ *   pause DUREE                     trame courante conservée
+ *   luminosite NIVEAU [FONDU]       luminosité (avec un fondu) à l'étape suivante
+ *   boucle                          point de reprise de la lecture en boucle
+ */
+
+#ifndef ANIMATIONAFFICHAGE_H
+#define	ANIMATIONAFFICHAGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include "Police7Segments.h"
+
+using namespace std;
+
+// En-tête du fichier (valeurs dans l'ordre des octets de la machine)
+struct EnTeteAnimation {
+    char magic[8];              // "7SEGANI"
+    uint32_t version;
+    uint32_t nbAfficheurs;
+    uint32_t tailleEtape;       // octets par étape, trame comprise
+    uint32_t nbEtapes;
+    uint64_t duree;             // fin de la dernière étape, en ms
+    uint32_t reprise;           // étape de reprise de la lecture en boucle
+    uint32_t reserve;
+};
+
+// En-tête d'une étape, suivi des nbAfficheurs octets de la trame (complétés
+// jusqu'à un multiple de 8 octets)
+struct EtapeAnimation {
+    enum : uint8_t {
+        TrameModifiee = 0x01,
+        LuminositeModifiee = 0x02
+    };
+    // Luminosité que l'animation n'a pas (encore) fixée
+    static const uint8_t luminositeLibre = 0xFF;
+
+    uint64_t instant;           // début de l'étape, en ms depuis le début
+    uint32_t fondu;             // durée du fondu vers 'luminosite', en ms
+    uint8_t luminosite;         // luminosité en vigueur pendant l'étape
+    uint8_t changements;        // ce que l'étape modifie
+    uint16_t reserve;
+};
+
+class AnimationAffichage {
+public:
+    static const uint32_t version = 1;
+
+    AnimationAffichage();
+    virtual ~AnimationAffichage();
+
+    // Projette le fichier en mémoire. Renvoie false (avec un message dans
+    // 'erreur') si le fichier ne peut être lu ou n'est pas une animation
+    bool open(const string& fichier, string& erreur);
+    void close();
+
+    int getNbAfficheurs() const;
+    size_t size() const;
+    uint64_t getDuree() const;
+    size_t getReprise() const;
+
+    const EtapeAnimation& etape(size_t i) const {
+        return *reinterpret_cast<const EtapeAnimation*>(this->etapes + i * this->tailleEtape);
+    }
+    const uint8_t* trame(size_t i) const {
+        return this->etapes + i * this->tailleEtape + sizeof(EtapeAnimation);
+    }
+
+    // Etape en cours à l'instant 't' (en ms depuis le début)
+    size_t chercher(uint64_t t) const;
+    // Annonce au noyau la lecture prochaine des 'n' étapes à partir de 'i'
+    void precharger(size_t i, size_t n) const;
+
+    // Compile le script 'script' pour un panneau de 'nbAfficheurs' afficheurs
+    // câblés selon 'orientation' dans le fichier 'fichier'. Renvoie false
+    // (avec un message et le numéro de ligne dans 'erreur') en cas de
+    // problème
+    static bool compile(istream& script, int nbAfficheurs, Orientation orientation,
+                        const string& fichier, string& erreur);
+
+private:
+    uint8_t* projection;
+    size_t taille;
+    const EnTeteAnimation* entete;
+    const uint8_t* etapes;
+    size_t tailleEtape;
+};
+
+#endif	/* ANIMATIONAFFICHAGE_H */
+
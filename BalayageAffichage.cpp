@@ -0,0 +1,253 @@
+/*
+ * File:   BalayageAffichage.cpp
+ * Author: olivier
+ */
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "BalayageAffichage.h"
+#include "PanneauAffichage.h"
+#include "TrameAffichage.h"
+#include "Instrumentation.h"
+
+// Masques de {LE, DATA, CLK} dans le port, comme pour PanneauAffichage
+static const TrameAffichage::Broches broches = {0x0, 0x1, 0x2, 0x4};
+
+// Balayages qui ont verrouillé la mémoire : mlockall() est commun à tout
+// le processus, elle n'est déverrouillée qu'à l'arrêt du dernier
+static std::mutex mutexVerrouillage;
+static int nbVerrouillages = 0;
+
+static bool verrouillerMemoire() {
+    std::lock_guard<std::mutex> lock(mutexVerrouillage);
+    if (nbVerrouillages == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        return false;
+    nbVerrouillages++;
+    return true;
+}
+
+static void deverrouillerMemoire() {
+    std::lock_guard<std::mutex> lock(mutexVerrouillage);
+    if (--nbVerrouillages == 0)
+        munlockall();
+}
+
+static void addNs(struct timespec& t, long ns) {
+    t.tv_nsec += ns;
+    while (t.tv_nsec >= 1000000000L) {
+        t.tv_nsec -= 1000000000L;
+        t.tv_sec++;
+    }
+}
+
+static int64_t diffNs(const struct timespec& a, const struct timespec& b) {
+    return (int64_t)(a.tv_sec - b.tv_sec) * 1000000000LL + (a.tv_nsec - b.tv_nsec);
+}
+
+BalayageAffichage::BalayageAffichage(CGPIOPort* port, CShiftTransport* transport, int nbAfficheurs,
+                                     const OptionsBalayage& options) {
+    this->port = port;
+    this->transport = transport;
+    this->nbAfficheurs = nbAfficheurs;
+    this->options = options;
+    this->nbSelection = (nbAfficheurs + 7) / 8;
+    this->periodeNs = 0;
+    this->sequence = 0;
+    this->depot.reset(new uint8_t[nbAfficheurs > 0 ? nbAfficheurs : 1]());
+    this->running = false;
+    this->creneaux = 0;
+    this->cycles = 0;
+    this->manquees = 0;
+    this->gigueTotale = 0;
+    this->gigueMax = 0;
+    this->tempsReel = false;
+    this->memoireVerrouillee = false;
+}
+
+BalayageAffichage::~BalayageAffichage() {
+    stop();
+}
+
+void BalayageAffichage::start() {
+    if (this->running)
+        return;
+    if (this->nbAfficheurs < 1)
+        throw (PanneauAffichage::Erreur("Le nombre d\'afficheur doit être supérieur ou égale à 1"));
+    if (this->options.frequence < 1)
+        throw (PanneauAffichage::Erreur("La fréquence de balayage doit être positive"));
+    if (this->options.priorite < 0 || this->options.priorite > 99)
+        throw (PanneauAffichage::Erreur("La priorité du balayage doit être comprise entre 0 et 99"));
+    this->periodeNs = 1000000000L / ((long)this->options.frequence * this->nbAfficheurs);
+    if (this->periodeNs < 1)
+        throw (PanneauAffichage::Erreur("Fréquence de balayage trop élevée"));
+
+    this->creneaux = 0;
+    this->cycles = 0;
+    this->manquees = 0;
+    this->gigueTotale = 0;
+    this->gigueMax = 0;
+
+    // Toute la mémoire du processus, présente et à venir : le thread de
+    // balayage ne doit jamais attendre une faute de page. Déverrouillée par
+    // stop(), sinon les allocations et les piles des threads créés ensuite
+    // resteraient comptées dans RLIMIT_MEMLOCK
+    this->memoireVerrouillee = this->options.verrouillerMemoire && verrouillerMemoire();
+
+    this->running = true;
+    this->thread = std::thread(&BalayageAffichage::run, this);
+
+    if (this->options.priorite > 0) {
+        struct sched_param param = {};
+        param.sched_priority = this->options.priorite;
+        this->tempsReel = pthread_setschedparam(this->thread.native_handle(), SCHED_FIFO, &param) == 0;
+    }
+    else
+        this->tempsReel = false;
+
+    if (this->options.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(this->options.cpu, &cpus);
+        int err = pthread_setaffinity_np(this->thread.native_handle(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            stop();
+            throw (PanneauAffichage::Erreur(string("Impossible de fixer le thread de balayage : ") + strerror(err)));
+        }
+    }
+}
+
+void BalayageAffichage::stop() {
+    if (!this->running)
+        return;
+    // Le thread se termine au plus tard à la fin du créneau en cours
+    this->running = false;
+    this->thread.join();
+    if (this->memoireVerrouillee)
+        deverrouillerMemoire();
+}
+
+void BalayageAffichage::setFrame(const uint8_t* octets) {
+    uint32_t s = this->sequence.load(std::memory_order_relaxed);
+    this->sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(this->depot.get(), octets, this->nbAfficheurs);
+    this->sequence.store(s + 2, std::memory_order_release);
+}
+
+StatistiquesBalayage BalayageAffichage::getStats() const {
+    StatistiquesBalayage s;
+    s.creneaux = this->creneaux.load(std::memory_order_relaxed);
+    s.cycles = this->cycles.load(std::memory_order_relaxed);
+    s.echeancesManquees = this->manquees.load(std::memory_order_relaxed);
+    s.gigueMoyenne = s.creneaux != 0 ? this->gigueTotale.load(std::memory_order_relaxed) / s.creneaux : 0;
+    s.gigueMax = this->gigueMax.load(std::memory_order_relaxed);
+    s.tempsReel = this->tempsReel;
+    s.memoireVerrouillee = this->memoireVerrouillee;
+    return s;
+}
+
+void BalayageAffichage::compile(const uint8_t* octets, vector<CGPIOStep>& steps, vector<uint8_t>& envois) const {
+    steps.clear();
+    envois.clear();
+    for (int k=0; k<this->nbAfficheurs; k++) {
+        // Segments de l'afficheur k, puis sa sélection
+        size_t debut = envois.size();
+        envois.push_back(octets != nullptr ? octets[k] : 0);
+        for (int i=0; i<this->nbSelection; i++) {
+            uint8_t selection = (octets != nullptr && i == k / 8) ? (uint8_t)(1 << (k % 8)) : 0;
+            envois.push_back(this->options.selectionActiveBas ? (uint8_t)~selection : selection);
+        }
+        if (this->transport == nullptr)
+            TrameAffichage::append(steps, envois.data() + debut, 1 + this->nbSelection, broches);
+    }
+}
+
+void BalayageAffichage::sendSlot(const CGPIOStep* steps, size_t n, const uint8_t* envoi) {
+    if (this->transport == nullptr) {
+        this->port->writeSequence(steps, n);
+        return;
+    }
+    if (!this->transport->send(envoi, 1 + this->nbSelection)) {
+        Instrumentation::countError(Instrumentation::Erreur::Transport);
+        return;
+    }
+    this->port->write(0x1, 0);
+    this->port->write(0, 0x1);
+}
+
+void BalayageAffichage::run() {
+    // Pile et tampons touchés avant le premier créneau : avec mlockall(),
+    // plus aucune faute de page ensuite
+    volatile uint8_t pile[64 * 1024];
+    for (size_t i=0; i<sizeof(pile); i+=4096)
+        pile[i] = 0;
+
+    vector<uint8_t> trame(this->nbAfficheurs, 0);
+    vector<CGPIOStep> steps;
+    vector<uint8_t> envois;
+    compile(trame.data(), steps, envois);
+    size_t parCreneau = steps.size() / this->nbAfficheurs;
+    size_t envoiParCreneau = 1 + this->nbSelection;
+    // Séquence impaire : la première trame déposée est toujours prise
+    uint32_t vue = 1;
+
+    struct timespec echeance;
+    clock_gettime(CLOCK_MONOTONIC, &echeance);
+    int k = 0;
+    while (this->running.load(std::memory_order_relaxed)) {
+        // Nouvelle trame au début d'un cycle, pour ne jamais mélanger deux
+        // trames. Un dépôt en cours n'est pas attendu (le thread qui dépose
+        // peut être moins prioritaire) : la trame précédente est gardée
+        if (k == 0) {
+            uint32_t s = this->sequence.load(std::memory_order_acquire);
+            if (s != vue && (s & 1) == 0) {
+                memcpy(trame.data(), this->depot.get(), this->nbAfficheurs);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (this->sequence.load(std::memory_order_relaxed) == s) {
+                    vue = s;
+                    compile(trame.data(), steps, envois);
+                }
+            }
+        }
+
+        sendSlot(steps.data() + k * parCreneau, parCreneau, envois.data() + k * envoiParCreneau);
+        this->creneaux.store(this->creneaux.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (++k == this->nbAfficheurs) {
+            k = 0;
+            this->cycles.store(this->cycles.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // Echéance du créneau suivant déjà passée : les créneaux en retard
+        // sont sautés plutôt qu'enchainés (l'afficheur courant reste allumé)
+        addNs(echeance, this->periodeNs);
+        struct timespec maintenant;
+        clock_gettime(CLOCK_MONOTONIC, &maintenant);
+        int64_t retard = diffNs(maintenant, echeance);
+        if (retard >= 0) {
+            int64_t sautes = retard / this->periodeNs + 1;
+            this->manquees.store(this->manquees.load(std::memory_order_relaxed) + sautes,
+                                 std::memory_order_relaxed);
+            int64_t ns = sautes * this->periodeNs;
+            echeance.tv_sec += ns / 1000000000LL;
+            addNs(echeance, ns % 1000000000LL);
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &echeance, nullptr) == EINTR)
+            ;
+        clock_gettime(CLOCK_MONOTONIC, &maintenant);
+        int64_t gigue = diffNs(maintenant, echeance);
+        uint64_t g = gigue > 0 ? gigue : 0;
+        this->gigueTotale.store(this->gigueTotale.load(std::memory_order_relaxed) + g, std::memory_order_relaxed);
+        if (g > this->gigueMax.load(std::memory_order_relaxed))
+            this->gigueMax.store(g, std::memory_order_relaxed);
+        Instrumentation::recordLatency(Instrumentation::Latence::GigueBalayage, g);
+    }
+
+    // Afficheurs éteints et désélectionnés : aucun ne reste allumé seul
+    compile(nullptr, steps, envois);
+    sendSlot(steps.data(), parCreneau, envois.data());
+}
@@ -0,0 +1,120 @@
+/*
+ * File:   BalayageAffichage.h
+ * Author: olivier
+ *
+ * Balayage (multiplexage) d'un panneau dont les afficheurs partagent les
+ * mêmes lignes de segments et sont sélectionnés un par un par des
+ * transistors d'anode commune. La chaine de registres à décalage ne
+ * contient alors qu'un octet de segments suivi d'un ou plusieurs octets
+ * de sélection (un bit par afficheur, 8 afficheurs par octet) : chaque
+ * créneau envoie les segments d'un afficheur et sa sélection, puis
+ * verrouille. Le premier octet envoyé (les segments) est le plus éloigné
+ * sur la chaine.
+ *
+ * Pour que l'oeil ne voie pas de scintillement, chaque afficheur doit
+ * être rafraîchi au moins 100 fois par seconde : le balayage est confié à
+ * un thread temps réel dédié :
+ * - ordonnancement SCHED_FIFO (priorité réglable) et mémoire verrouillée
+ *   par mlockall() tant que le balayage tourne, pour ne pas être retardé
+ *   par les autres threads ni par une faute de page ;
+ * - thread éventuellement fixé sur un coeur ;
+ * - réveils à échéances absolues (clock_nanosleep(TIMER_ABSTIME)) : le
+ *   retard d'un créneau ne décale pas les suivants.
+ * Sans les droits nécessaires (CAP_SYS_NICE, RLIMIT_MEMLOCK), le balayage
+ * tourne quand même en ordonnancement normal, ce qu'indiquent les
+ * statistiques.
+ *
+ * La trame est déposée par setFrame() sans jamais bloquer le thread de
+ * balayage (verrou de séquence) : il la prend au début d'un cycle
+ * complet, ou garde la précédente si un dépôt est en cours. Le retard de
+ * chaque réveil (gigue) et les échéances manquées sont comptés.
+ */
+
+#ifndef BALAYAGEAFFICHAGE_H
+#define	BALAYAGEAFFICHAGE_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "GPIOPort.h"
+#include "ShiftTransport.h"
+
+struct OptionsBalayage {
+    // Rafraîchissements par seconde de chaque afficheur
+    int frequence = 200;
+    // Priorité SCHED_FIFO du thread (1 à 99), 0 pour l'ordonnancement normal
+    int priorite = 80;
+    // Coeur sur lequel fixer le thread (-1 : aucun)
+    int cpu = -1;
+    // Verrouillage en mémoire de tout le processus (mlockall)
+    bool verrouillerMemoire = true;
+    // Afficheur sélectionné par un 0 plutôt que par un 1
+    bool selectionActiveBas = false;
+};
+
+struct StatistiquesBalayage {
+    uint64_t creneaux;          // créneaux affichés (un afficheur chacun)
+    uint64_t cycles;            // balayages complets du panneau
+    uint64_t echeancesManquees; // créneaux sautés faute d'avoir tenu l'échéance
+    uint64_t gigueMoyenne;      // retard moyen du réveil sur l'échéance, en ns
+    uint64_t gigueMax;          // retard maximal, en ns
+    bool tempsReel;             // SCHED_FIFO obtenu
+    bool memoireVerrouillee;    // mlockall() réussi
+};
+
+class BalayageAffichage {
+public:
+    // port : {LE, DATA, CLK} déjà initialisé (ou LE seule avec un
+    // transport), utilisé par le seul thread de balayage tant qu'il tourne
+    BalayageAffichage(CGPIOPort* port, CShiftTransport* transport, int nbAfficheurs,
+                      const OptionsBalayage& options = OptionsBalayage());
+    virtual ~BalayageAffichage();
+
+    // Lancement et arrêt du thread de balayage (les afficheurs sont éteints
+    // à l'arrêt). Lèvent une exception PanneauAffichage::Erreur en cas de
+    // problème
+    void start();
+    void stop();
+
+    // Dépôt sans attente d'une trame (un octet de segments par afficheur),
+    // depuis un seul thread à la fois
+    void setFrame(const uint8_t* octets);
+
+    StatistiquesBalayage getStats() const;
+
+private:
+    CGPIOPort* port;
+    CShiftTransport* transport;
+    int nbAfficheurs;
+    OptionsBalayage options;
+    int nbSelection;            // octets de sélection
+    long periodeNs;             // durée d'un créneau
+
+    // Trame déposée, protégée par un verrou de séquence (impaire pendant
+    // une écriture)
+    std::atomic<uint32_t> sequence;
+    std::unique_ptr<uint8_t[]> depot;
+
+    std::atomic<bool> running;
+    std::thread thread;
+
+    // Statistiques, écrites par le seul thread de balayage
+    std::atomic<uint64_t> creneaux;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> manquees;
+    std::atomic<uint64_t> gigueTotale;
+    std::atomic<uint64_t> gigueMax;
+    std::atomic<bool> tempsReel;
+    std::atomic<bool> memoireVerrouillee;
+
+    void run();
+    // Séquences des créneaux de la trame 'octets', mises bout à bout
+    // (chaque créneau a la même longueur)
+    void compile(const uint8_t* octets, vector<CGPIOStep>& steps, vector<uint8_t>& envois) const;
+    void sendSlot(const CGPIOStep* steps, size_t n, const uint8_t* envoi);
+};
+
+#endif	/* BALAYAGEAFFICHAGE_H */
+
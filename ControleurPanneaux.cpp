@@ -0,0 +1,304 @@
+/*
+ * File:   ControleurPanneaux.cpp
+ * Author: olivier
+ */
+#include <algorithm>
+#include <charconv>
+#include "ControleurPanneaux.h"
+
+const int ControleurPanneaux::lignesMax;
+
+ControleurPanneaux::ControleurPanneaux(int pinData, int pinClk, CGPIOBackend* backend,
+                                       std::chrono::microseconds periode) {
+    this->pinData = pinData;
+    this->pinClk = pinClk;
+    this->backend = (backend != nullptr) ? backend : CGPIO::getDefaultBackend();
+    this->periode = periode;
+    this->isInitialized = false;
+    this->running = false;
+    this->enCours = false;
+    this->nbModifiees = 0;
+    setOrientation(Orientation::DPBas);
+}
+
+ControleurPanneaux::~ControleurPanneaux() {
+    // Broches libérées même si close() n'a pas été appelée. Un destructeur
+    // ne doit pas lever d'exception : les erreurs de fermeture sont ignorées
+    try {
+        close();
+    }
+    catch (PanneauAffichage::Erreur& e) {
+    }
+}
+
+int ControleurPanneaux::addPanel(int nbAfficheurs, int pinOE, int pinLE) {
+    if (this->isInitialized)
+        throw (PanneauAffichage::Erreur("Les panneaux doivent être ajoutés avant l\'initialisation"));
+    if (nbAfficheurs < 1)
+        throw (PanneauAffichage::Erreur("Le nombre d\'afficheur doit être supérieur ou égale à 1"));
+
+    Panneau panneau;
+    panneau.nbAfficheurs = nbAfficheurs;
+    panneau.pinOE = pinOE;
+    panneau.pinLE = pinLE;
+
+    // Une ligne LE déjà utilisée : le panneau prolonge la chaine existante
+    auto chaine = std::find_if(this->chaines.begin(), this->chaines.end(),
+                               [pinLE](const std::unique_ptr<Chaine>& c) { return c->pinLE == pinLE; });
+    if (chaine == this->chaines.end()) {
+        if ((int)this->chaines.size() == lignesMax)
+            throw (PanneauAffichage::Erreur("Trop de lignes LE"));
+        this->chaines.emplace_back(new Chaine(pinLE));
+        chaine = this->chaines.end() - 1;
+    }
+    panneau.chaine = chaine - this->chaines.begin();
+    panneau.decalage = (*chaine)->trame.size();
+    (*chaine)->trame = TrameAffichage(panneau.decalage + nbAfficheurs);
+
+    auto sortie = std::find_if(this->sorties.begin(), this->sorties.end(),
+                               [pinOE](const Sortie& s) { return s.pinOE == pinOE; });
+    if (sortie == this->sorties.end()) {
+        this->sorties.push_back(Sortie());
+        this->sorties.back().pinOE = pinOE;
+        sortie = this->sorties.end() - 1;
+    }
+    panneau.sortie = sortie - this->sorties.begin();
+
+    this->panneaux.push_back(panneau);
+    return this->panneaux.size() - 1;
+}
+
+int ControleurPanneaux::getPanelCount() const {
+    return this->panneaux.size();
+}
+
+void ControleurPanneaux::setOrientation(Orientation orientation) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (orientation == Orientation::DPBas) {
+        this->police = Police7Segments<Orientation::DPBas>::table.data();
+        this->pointDecimal = Police7Segments<Orientation::DPBas>::pointDecimal;
+    }
+    else {
+        this->police = Police7Segments<Orientation::DPHaut>::table.data();
+        this->pointDecimal = Police7Segments<Orientation::DPHaut>::pointDecimal;
+    }
+}
+
+void ControleurPanneaux::init() {
+    if (this->isInitialized)
+        return;
+
+    if (this->panneaux.empty())
+        throw (PanneauAffichage::Erreur("Aucun panneau n\'a été ajouté"));
+
+    // Broches de sortie : DATA, CLK, puis les lignes LE et OE distinctes
+    vector<int> pins = {this->pinData, this->pinClk};
+    for (const auto& chaine : this->chaines)
+        pins.push_back(chaine->pinLE);
+    for (const Sortie& sortie : this->sorties)
+        pins.push_back(sortie.pinOE);
+
+    for (size_t i=0; i<pins.size(); i++) {
+        if (pins[i] < 0)
+            throw (PanneauAffichage::Erreur("Une broche ne peut avoir une valeur negative"));
+        for (size_t j=0; j<i; j++) {
+            if (pins[i] == pins[j])
+                throw (PanneauAffichage::Erreur("Les broches DATA, CLK, LE et OE doivent être différentes"));
+        }
+    }
+
+    // DATA, CLK et les lignes LE sont réservées ensemble (une seule requête
+    // avec le périphérique GPIO) et forment le port du bus
+    std::unique_ptr<CGPIOPort> port(new CGPIOPort(pins.data(), 2 + this->chaines.size(), this->backend));
+    if (!port->init())
+        throw (PanneauAffichage::Erreur(port->getLastError()));
+    this->port = std::move(port);
+
+    // Sorties désactivées au départ, comme pour un panneau seul. En cas
+    // d'échec, les broches déjà réservées sont libérées et init() peut être
+    // rappelée
+    for (Sortie& sortie : this->sorties) {
+        std::unique_ptr<CGPIO> oe(new CGPIO(sortie.pinOE, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::HIGH, this->backend));
+        if (!oe->init()) {
+            string erreur = oe->getLastError();
+            release();
+            throw (PanneauAffichage::Erreur(erreur));
+        }
+        sortie.oe = std::move(oe);
+        sortie.luminosite.reset(new MoteurLuminosite(sortie.oe.get()));
+        sortie.luminosite->start();
+    }
+
+    // L'état des registres à décalage est inconnu : toutes les chaines sont
+    // envoyées au premier cycle
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto& chaine : this->chaines) {
+        chaine->trame.invalidate();
+        markModified(*chaine);
+    }
+    this->running = true;
+    this->thread = std::thread(&ControleurPanneaux::run, this);
+    this->isInitialized = true;
+}
+
+void ControleurPanneaux::close() {
+    if (!this->isInitialized)
+        return;
+    this->isInitialized = false;
+
+    // Les trames en attente sont envoyées avant l'arrêt du thread
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->running = false;
+    }
+    this->condition.notify_one();
+    this->thread.join();
+
+    string erreur = release();
+    if (!erreur.empty())
+        throw (PanneauAffichage::Erreur(erreur));
+}
+
+string ControleurPanneaux::release() {
+    // Les moteurs de luminosité utilisent OE : ils sont arrêtés en premier.
+    // Toutes les broches sont libérées, même si l'une d'elles échoue
+    string erreur;
+    for (Sortie& sortie : this->sorties) {
+        sortie.luminosite.reset();
+        if (sortie.oe && !sortie.oe->close() && erreur.empty())
+            erreur = sortie.oe->getLastError();
+        sortie.oe.reset();
+    }
+    if (this->port && !this->port->close() && erreur.empty())
+        erreur = this->port->getLastError();
+    this->port.reset();
+    return erreur;
+}
+
+const ControleurPanneaux::Panneau& ControleurPanneaux::panel(int panneau) const {
+    if (panneau < 0 || panneau >= (int)this->panneaux.size())
+        throw (PanneauAffichage::Erreur("Numéro de panneau invalide"));
+    return this->panneaux[panneau];
+}
+
+void ControleurPanneaux::setBrightness(int panneau, int level) {
+    const Sortie& sortie = this->sorties[panel(panneau).sortie];
+    if (!sortie.luminosite)
+        throw (PanneauAffichage::Erreur("Le contrôleur doit être initialisé"));
+    sortie.luminosite->setBrightness(level);
+}
+
+std::future<void> ControleurPanneaux::fadeTo(int panneau, int level, std::chrono::milliseconds duration,
+                                             std::function<void()> onDone) {
+    const Sortie& sortie = this->sorties[panel(panneau).sortie];
+    if (!sortie.luminosite)
+        throw (PanneauAffichage::Erreur("Le contrôleur doit être initialisé"));
+    return sortie.luminosite->fadeTo(level, duration, onDone);
+}
+
+void ControleurPanneaux::displayText(int panneau, std::string_view text) {
+    const Panneau& p = panel(panneau);
+    Chaine& chaine = *this->chaines[p.chaine];
+
+    // encoderTexte() remplit les octets au fil du texte : la conversion est
+    // faite dans un tampon local (sur la pile pour les panneaux courants)
+    // pour qu'un échec ne laisse pas une trame à moitié écrite dans celle
+    // de la chaine, envoyée à la prochaine mise à jour d'un de ses panneaux
+    uint8_t local[64];
+    std::unique_ptr<uint8_t[]> alloue;
+    uint8_t* tampon = local;
+    if (p.nbAfficheurs > (int)sizeof(local)) {
+        alloue.reset(new uint8_t[p.nbAfficheurs]);
+        tampon = alloue.get();
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    char invalide;
+    switch (encoderTexte(text, this->police, this->pointDecimal, tampon, p.nbAfficheurs, invalide)) {
+        case ResultatTexte::CaractereInvalide:
+            throw (PanneauAffichage::Erreur(string("Caractère non affichable : ") + invalide));
+        case ResultatTexte::TropLong:
+            throw (PanneauAffichage::Erreur("Texte trop long pour être affiché"));
+        default:
+            break;
+    }
+    std::copy(tampon, tampon + p.nbAfficheurs, chaine.trame.bytes() + p.decalage);
+    markModified(chaine);
+}
+
+void ControleurPanneaux::displayNumber(int panneau, int64_t value) {
+    // Conversion sans allocation (20 chiffres et le signe au plus)
+    char texte[21];
+    char* fin = std::to_chars(texte, texte + sizeof(texte), value).ptr;
+    displayText(panneau, std::string_view(texte, fin - texte));
+}
+
+void ControleurPanneaux::setFrame(int panneau, const uint8_t* octets) {
+    const Panneau& p = panel(panneau);
+    Chaine& chaine = *this->chaines[p.chaine];
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::copy(octets, octets + p.nbAfficheurs, chaine.trame.bytes() + p.decalage);
+    markModified(chaine);
+}
+
+void ControleurPanneaux::flush() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->envoye.wait(lock, [this] { return !this->running || (this->nbModifiees == 0 && !this->enCours); });
+}
+
+void ControleurPanneaux::markModified(Chaine& chaine) {
+    if (chaine.modifiee)
+        return;
+    chaine.modifiee = true;
+    this->nbModifiees++;
+    this->condition.notify_one();
+}
+
+void ControleurPanneaux::run() {
+    auto prochain = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (;;) {
+        this->condition.wait(lock, [this] { return !this->running || this->nbModifiees > 0; });
+        if (this->nbModifiees == 0)
+            break;
+
+        // Regroupement des modifications jusqu'à la fin de la période (un
+        // arrêt envoie immédiatement les trames en attente)
+        this->condition.wait_until(lock, prochain, [this] { return !this->running; });
+
+        size_t n = build();
+        this->enCours = true;
+        lock.unlock();
+        if (n > 0)
+            this->port->writeSequence(this->steps.data(), this->steps.size());
+        prochain = std::chrono::steady_clock::now() + this->periode;
+        lock.lock();
+        this->enCours = false;
+        this->envoye.notify_all();
+    }
+    this->envoye.notify_all();
+}
+
+size_t ControleurPanneaux::build() {
+    size_t n = 0;
+    this->steps.clear();
+    for (size_t i=0; i<this->chaines.size(); i++) {
+        Chaine& chaine = *this->chaines[i];
+        if (!chaine.modifiee)
+            continue;
+        chaine.modifiee = false;
+        if (chaine.trame.isLatched())
+            continue;
+
+        // Les bits décalés traversent toutes les chaines, seule celle dont
+        // LE est activée les transfère sur ses sorties
+        TrameAffichage::Broches broches = {0x0, 1u << (2 + i), 0x1, 0x2};
+        TrameAffichage::append(this->steps, chaine.trame.bytes(), chaine.trame.size(), broches);
+        chaine.trame.latch();
+        n++;
+    }
+    this->nbModifiees = 0;
+    return n;
+}
@@ -0,0 +1,146 @@
+/*
+ * File:   ControleurPanneaux.h
+ * Author: olivier
+ *
+ * Pilotage de plusieurs panneaux par un seul processus, sur un bus
+ * DATA/CLK commun :
+ * - chaque panneau a sa propre ligne LE : toutes les chaines reçoivent
+ *   les bits décalés mais seul le panneau dont LE est activée les
+ *   transfère sur ses sorties ;
+ * - des panneaux qui partagent la même ligne LE forment une seule chaine
+ *   (panneaux en cascade), dans l'ordre où ils sont ajoutés, le premier
+ *   étant le plus éloigné du contrôleur.
+ * Les deux montages peuvent être mélangés. OE peut aussi être commune à
+ * plusieurs panneaux : la luminosité est réglée par broche OE.
+ *
+ * Les méthodes display...() ne font que modifier la trame du panneau en
+ * mémoire. Un thread d'E/S unique regroupe toutes les chaines modifiées
+ * dans une seule séquence d'écritures par cycle, au plus une fois par
+ * période, sur un port {DATA, CLK, LE...} (CGPIOPort::writeSequence) :
+ * comme pour un panneau seul, les écritures sont comptées par
+ * l'instrumentation et relevées par l'enregistreur de broches. Le port
+ * limite le bus à 30 lignes LE.
+ */
+
+#ifndef CONTROLEURPANNEAUX_H
+#define	CONTROLEURPANNEAUX_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "GPIOClass.h"
+#include "GPIOPort.h"
+#include "TrameAffichage.h"
+#include "MoteurLuminosite.h"
+#include "Police7Segments.h"
+#include "PanneauAffichage.h"
+
+class ControleurPanneaux {
+public:
+    // periode : intervalle minimal entre deux cycles d'envoi, les
+    // modifications faites entre-temps sont regroupées
+    ControleurPanneaux(int pinData, int pinClk, CGPIOBackend* backend = nullptr,
+                       std::chrono::microseconds periode = std::chrono::microseconds(10000));
+    virtual ~ControleurPanneaux();
+
+    // Ajoute un panneau (avant init()) et renvoie son numéro. Lève une
+    // exception PanneauAffichage::Erreur au-delà de lignesMax lignes LE
+    int addPanel(int nbAfficheurs, int pinOE, int pinLE);
+    int getPanelCount() const;
+
+    void setOrientation(Orientation orientation);
+
+    // Les méthodes suivantes lèvent une exception PanneauAffichage::Erreur
+    // en cas de problème. Si init() échoue, tout ce qui a été réservé est
+    // libéré ; close() libère toutes les broches et signale la première
+    // erreur
+    void init();
+    void close();
+
+    // Luminosité de tous les panneaux reliés à la même broche OE que 'panneau'
+    void setBrightness(int panneau, int level);
+    std::future<void> fadeTo(int panneau, int level, std::chrono::milliseconds duration,
+                             std::function<void()> onDone = nullptr);
+
+    // Mise à jour de la trame d'un panneau, envoyée au prochain cycle
+    void displayText(int panneau, std::string_view text);
+    void displayNumber(int panneau, int64_t value);
+    // Octets de segments bruts, un par afficheur
+    void setFrame(int panneau, const uint8_t* octets);
+
+    // Attend que toutes les trames modifiées aient été envoyées
+    void flush();
+
+    // Lignes LE du port : les masques sont sur 32 bits (DATA et CLK
+    // occupent les deux premiers)
+    static const int lignesMax = CGPIOPort::maxPins - 2;
+
+private:
+
+    struct Panneau {
+        int nbAfficheurs;
+        int pinOE;
+        int pinLE;
+        int chaine;
+        int decalage;           // position du panneau dans la trame de la chaine
+        int sortie;             // index dans 'sorties' (moteur de luminosité)
+    };
+
+    // Panneaux partageant une ligne LE : une seule trame
+    struct Chaine {
+        int pinLE;
+        TrameAffichage trame;
+        bool modifiee;
+
+        Chaine(int pinLE) : pinLE(pinLE), trame(0), modifiee(false) {}
+    };
+
+    struct Sortie {
+        int pinOE;
+        std::unique_ptr<CGPIO> oe;
+        std::unique_ptr<MoteurLuminosite> luminosite;
+    };
+
+    int pinData, pinClk;
+    CGPIOBackend* backend;
+    std::chrono::microseconds periode;
+    // Bus {DATA, CLK, LE...}, la i-ème chaine sur le bit 2 + i
+    std::unique_ptr<CGPIOPort> port;
+    vector<Panneau> panneaux;
+    vector<std::unique_ptr<Chaine>> chaines;
+    vector<Sortie> sorties;
+    bool isInitialized;
+
+    const uint16_t* police;
+    uint8_t pointDecimal;
+
+    // Thread d'E/S : 'mutex' protège les trames et les indicateurs
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable envoye;
+    bool running;
+    bool enCours;
+    int nbModifiees;
+
+    // Séquence du cycle en cours (réutilisée d'un cycle à l'autre)
+    vector<CGPIOStep> steps;
+
+    const Panneau& panel(int panneau) const;
+    void markModified(Chaine& chaine);
+    void run();
+    // Construit, sous verrou, la séquence des chaines modifiées dont la
+    // trame diffère de celle déjà verrouillée, et renvoie leur nombre
+    size_t build();
+    // Arrête les moteurs de luminosité et libère toutes les broches
+    // réservées, renvoie la première erreur (vide si aucune)
+    string release();
+};
+
+#endif	/* CONTROLEURPANNEAUX_H */
+
@@ -0,0 +1,98 @@
+/*
+ * File:   DemonAffichage.cpp
+ * Author: olivier
+ */
+#include <iostream>
+#include <algorithm>
+#include "DemonAffichage.h"
+
+DemonAffichage::DemonAffichage(const string& nom, std::chrono::microseconds periode, const string& groupe) {
+    this->nom = nom;
+    this->groupe = groupe;
+    this->periode = periode;
+    this->running = false;
+    this->envoyees = 0;
+}
+
+DemonAffichage::~DemonAffichage() {
+    stop();
+}
+
+int DemonAffichage::addPanel(PanneauAffichage* panneau) {
+    if (this->running)
+        throw (PanneauAffichage::Erreur("Les panneaux doivent être ajoutés avant le lancement du démon"));
+    Sortie s;
+    s.panneau = panneau;
+    s.sequence = 0;
+    s.luminosite = -1;
+    s.trame.resize(panneau->getNbAfficheurs());
+    this->sorties.push_back(s);
+    return this->sorties.size() - 1;
+}
+
+void DemonAffichage::start() {
+    if (this->running)
+        return;
+
+    vector<int> nbAfficheurs;
+    for (const Sortie& s : this->sorties)
+        nbAfficheurs.push_back(s.panneau->getNbAfficheurs());
+    this->tampon = TamponAffichage::create(this->nom, nbAfficheurs, this->groupe);
+
+    this->running = true;
+    this->thread = std::thread(&DemonAffichage::run, this);
+}
+
+void DemonAffichage::stop() {
+    if (!this->running)
+        return;
+    this->running = false;
+    this->tampon->notify();
+    this->thread.join();
+    this->tampon.reset();
+}
+
+uint64_t DemonAffichage::getFramesSent() const {
+    return this->envoyees.load(std::memory_order_relaxed);
+}
+
+void DemonAffichage::run() {
+    typedef std::chrono::steady_clock horloge;
+    // Réveil périodique pour vérifier 'running' même sans notification
+    const std::chrono::milliseconds attenteMax(1000);
+
+    horloge::time_point prochain = horloge::now();
+    while (this->running) {
+        horloge::time_point debut = horloge::now();
+        // Lue avant les trames : un dépôt fait pendant les envois change la
+        // génération et l'attente suivante retourne immédiatement
+        uint32_t generation = this->tampon->getGeneration();
+
+        for (size_t i=0; i<this->sorties.size(); i++) {
+            Sortie& s = this->sorties[i];
+            try {
+                int luminosite = this->tampon->getBrightness(i);
+                if (luminosite >= 0 && luminosite != s.luminosite) {
+                    s.panneau->setBrightness(luminosite);
+                    s.luminosite = luminosite;
+                }
+                if (this->tampon->read(i, s.trame.data(), s.sequence)) {
+                    s.panneau->displayFrame(s.trame.data());
+                    this->envoyees.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            catch (PanneauAffichage::Erreur& e) {
+                cerr << "DemonAffichage : " << e.what() << endl;
+            }
+        }
+
+        // Débit borné : pas plus d'un cycle d'envoi par période (aprés une
+        // longue attente, la période repart du début de ce cycle)
+        prochain = std::max(prochain + this->periode,
+                            std::chrono::time_point_cast<horloge::duration>(debut + this->periode));
+        std::this_thread::sleep_until(prochain);
+
+        if (this->running)
+            this->tampon->wait(generation, attenteMax);
+    }
+}
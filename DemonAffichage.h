@@ -0,0 +1,73 @@
+/*
+ * File:   DemonAffichage.h
+ * Author: olivier
+ *
+ * Démon d'affichage : seul propriétaire des panneaux (et donc des
+ * broches), il publie un TamponAffichage en mémoire partagée dans lequel
+ * n'importe quel processus local dépose ses trames.
+ *
+ * Un thread dort sur le futex du tampon, copie les trames modifiées
+ * (verrou de séquence) et les envoie aux panneaux, au plus une fois par
+ * période : des dépôts rapprochés sont regroupés en un seul envoi. Les
+ * panneaux restent initialisés tant que le démon tourne, les clients ne
+ * touchent jamais aux broches.
+ */
+
+#ifndef DEMONAFFICHAGE_H
+#define	DEMONAFFICHAGE_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PanneauAffichage.h"
+#include "TamponAffichage.h"
+
+class DemonAffichage {
+public:
+    // nom : nom du tampon en mémoire partagée (par exemple "/afficheur7seg")
+    // periode : intervalle minimal entre deux envois à un même panneau
+    // groupe : groupe des clients autorisés à écrire dans le tampon (celui
+    // du démon si vide)
+    DemonAffichage(const string& nom, std::chrono::microseconds periode = std::chrono::microseconds(10000),
+                   const string& groupe = "");
+    virtual ~DemonAffichage();
+
+    // Ajoute un panneau déjà initialisé (avant start()), qui doit exister
+    // tant que le démon tourne. Renvoie son numéro dans le tampon
+    int addPanel(PanneauAffichage* panneau);
+
+    // Crée le tampon et lance le thread d'envoi, ou l'arrête (le tampon
+    // est alors supprimé). Lèvent une exception PanneauAffichage::Erreur
+    // en cas de problème
+    void start();
+    void stop();
+
+    // Nombre de trames envoyées aux panneaux
+    uint64_t getFramesSent() const;
+
+private:
+    struct Sortie {
+        PanneauAffichage* panneau;
+        uint32_t sequence;      // séquence de la dernière trame envoyée
+        int luminosite;         // dernière luminosité appliquée (-1 : aucune)
+        vector<uint8_t> trame;
+    };
+
+    string nom;
+    string groupe;
+    std::chrono::microseconds periode;
+    vector<Sortie> sorties;
+    std::unique_ptr<TamponAffichage> tampon;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> envoyees;
+    std::thread thread;
+
+    void run();
+};
+
+#endif	/* DEMONAFFICHAGE_H */
+
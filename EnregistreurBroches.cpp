@@ -0,0 +1,437 @@
+/*
+ * File:   EnregistreurBroches.cpp
+ * Author: olivier
+ */
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "EnregistreurBroches.h"
+
+const size_t EnregistreurBroches::capaciteAnneau;
+const size_t EnregistreurBroches::tailleBloc;
+const int EnregistreurBroches::brocheMax;
+
+std::atomic<bool> EnregistreurBroches::actif(false);
+
+namespace {
+
+const char magic[8] = {'7', 'S', 'E', 'G', 'E', 'N', 'R', '\0'};
+const uint32_t version = 1;
+const size_t motsParBloc = EnregistreurBroches::tailleBloc / sizeof(uint64_t);
+const uint64_t masqueAnneau = EnregistreurBroches::capaciteAnneau - 1;
+
+// Un changement dans le fichier : bit 63 à 1 (mot utilisé), bit 62 niveau,
+// bits 48 à 61 broche, bits 0 à 47 écart signé à la date du bloc (environ
+// 39 heures de part et d'autre)
+const uint64_t motUtilise = 1ULL << 63;
+const int64_t ecartMax = (1LL << 47) - 1;
+
+// En-tête du fichier, seul dans le premier bloc. Les blocs de données sont
+// numérotés dans l'ordre de leur écriture : le bloc n est rangé à la place
+// n % nbBlocs
+struct EnTete {
+    char magic[8];
+    uint32_t version;
+    uint32_t tailleBloc;
+    uint64_t nbBlocs;
+    int64_t debutReel;          // CLOCK_REALTIME au lancement, en ns
+    uint64_t debutMonotone;     // CLOCK_MONOTONIC au lancement, en ns
+    uint64_t blocsEcrits;
+    uint64_t perdus;
+};
+
+static_assert(sizeof(EnTete) <= EnregistreurBroches::tailleBloc, "l\'en-tête tient dans un bloc");
+
+// Anneau à plusieurs producteurs et un seul consommateur (le thread de
+// vidage). Chaque case porte un numéro de séquence : 'pos' si elle est
+// libre pour la réservation 'pos', 'pos + 1' une fois remplie. Le
+// consommateur libère les cases dans l'ordre : si la dernière case d'une
+// réservation est libre, toutes les précédentes le sont aussi
+struct Case {
+    std::atomic<uint64_t> sequence;
+    uint64_t date;
+    uint32_t broche;
+    uint32_t niveau;
+};
+
+struct Anneau {
+    Case cases[EnregistreurBroches::capaciteAnneau];
+    alignas(64) std::atomic<uint64_t> tete;     // prochaine case à réserver
+    alignas(64) uint64_t queue;                 // prochaine case à lire
+    std::atomic<uint64_t> perdus;
+
+    Anneau() {
+        for (size_t i=0; i<EnregistreurBroches::capaciteAnneau; i++)
+            this->cases[i].sequence.store(i, std::memory_order_relaxed);
+        this->tete.store(0, std::memory_order_relaxed);
+        this->queue = 0;
+        this->perdus.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Jamais libéré : un producteur qui a testé isEnabled() juste avant
+// stop() peut encore y déposer ses changements
+Anneau& anneau() {
+    static Anneau* a = new Anneau();
+    return *a;
+}
+
+// Réserve 'n' cases consécutives, renvoie false si l'anneau est plein
+bool reserver(Anneau& a, size_t n, uint64_t& pos) {
+    if (n == 0 || n > EnregistreurBroches::capaciteAnneau)
+        return false;
+    pos = a.tete.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t derniere = pos + n - 1;
+        uint64_t sequence = a.cases[derniere & masqueAnneau].sequence.load(std::memory_order_acquire);
+        int64_t ecart = (int64_t)(sequence - derniere);
+        if (ecart == 0) {
+            if (a.tete.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                return true;
+        }
+        else if (ecart < 0)
+            return false;
+        else
+            pos = a.tete.load(std::memory_order_relaxed);
+    }
+}
+
+inline void deposer(Anneau& a, uint64_t pos, uint64_t date, int broche, bool niveau) {
+    Case& c = a.cases[pos & masqueAnneau];
+    c.date = date;
+    c.broche = broche;
+    c.niveau = niveau;
+    c.sequence.store(pos + 1, std::memory_order_release);
+}
+
+// Thread de vidage et fichier projeté
+struct Vidage {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread thread;
+    bool running = false;
+    std::chrono::milliseconds periode;
+
+    void* carte = nullptr;
+    size_t taille = 0;
+    EnTete* entete = nullptr;
+    uint64_t* donnees = nullptr;
+    uint64_t* bloc = nullptr;   // bloc en cours de remplissage
+    size_t position = 0;        // prochain mot libre du bloc
+    uint64_t base = 0;          // date de référence du bloc
+};
+
+Vidage& vidage() {
+    static Vidage v;
+    return v;
+}
+
+void nouveauBloc(Vidage& v, uint64_t date) {
+    uint64_t numero = v.entete->blocsEcrits;
+    v.bloc = v.donnees + (numero % v.entete->nbBlocs) * motsParBloc;
+    // Le bloc est effacé avant d'être compté : un lecteur ne prend jamais
+    // les changements d'un tour précédent pour ceux de la nouvelle date
+    memset(v.bloc, 0, EnregistreurBroches::tailleBloc);
+    v.bloc[0] = date;
+    v.base = date;
+    v.position = 1;
+    v.entete->blocsEcrits = numero + 1;
+}
+
+void ecrire(Vidage& v, uint64_t date, uint32_t broche, bool niveau) {
+    int64_t ecart = (int64_t)(date - v.base);
+    if (v.bloc == nullptr || v.position == motsParBloc || ecart > ecartMax || ecart < -ecartMax) {
+        nouveauBloc(v, date);
+        ecart = 0;
+    }
+    v.bloc[v.position++] = motUtilise | ((uint64_t)niveau << 62) | ((uint64_t)broche << 48) |
+                           ((uint64_t)ecart & 0xFFFFFFFFFFFFULL);
+}
+
+// Vide l'anneau dans le fichier (ou l'oublie si 'v' n'a pas de fichier)
+void vider(Anneau& a, Vidage* v) {
+    for (;;) {
+        Case& c = a.cases[a.queue & masqueAnneau];
+        if (c.sequence.load(std::memory_order_acquire) != a.queue + 1)
+            break;
+        if (v != nullptr)
+            ecrire(*v, c.date, c.broche, c.niveau);
+        c.sequence.store(a.queue + EnregistreurBroches::capaciteAnneau, std::memory_order_release);
+        a.queue++;
+    }
+    if (v != nullptr)
+        v->entete->perdus = a.perdus.load(std::memory_order_relaxed);
+}
+
+void executerVidage() {
+    Vidage& v = vidage();
+    Anneau& a = anneau();
+    std::unique_lock<std::mutex> lock(v.mutex);
+    while (v.running) {
+        v.condition.wait_for(lock, v.periode);
+        vider(a, &v);
+    }
+}
+
+void fermer(Vidage& v) {
+    if (v.carte != nullptr) {
+        msync(v.carte, v.taille, MS_ASYNC);
+        munmap(v.carte, v.taille);
+    }
+    v.carte = nullptr;
+    v.entete = nullptr;
+    v.donnees = nullptr;
+    v.bloc = nullptr;
+}
+
+// Identifiant VCD : caractères imprimables de '!' à '~'
+string identifiant(size_t n) {
+    string id;
+    do {
+        id += (char)('!' + n % 94);
+        n /= 94;
+    } while (n != 0);
+    return id;
+}
+
+}
+
+bool EnregistreurBroches::start(const string& fichier, size_t taille, std::chrono::milliseconds periode,
+                                string& erreur) {
+    Vidage& v = vidage();
+    std::lock_guard<std::mutex> lock(v.mutex);
+    if (v.running) {
+        erreur = "L\'enregistrement des broches est déjà lancé";
+        return false;
+    }
+    taille -= taille % tailleBloc;
+    if (taille < 2 * tailleBloc) {
+        erreur = "Le fichier d\'enregistrement doit faire au moins " + to_string(2 * tailleBloc) + " octets";
+        return false;
+    }
+
+    int fd = ::open(fichier.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        erreur = "Impossible de créer " + fichier + " : " + strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, taille) != 0) {
+        erreur = "Impossible de dimensionner " + fichier + " : " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    void* carte = mmap(nullptr, taille, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (carte == MAP_FAILED) {
+        erreur = "Impossible de projeter " + fichier + " : " + strerror(errno);
+        return false;
+    }
+
+    v.carte = carte;
+    v.taille = taille;
+    v.entete = static_cast<EnTete*>(carte);
+    v.donnees = reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(carte) + tailleBloc);
+    v.bloc = nullptr;
+    v.periode = periode;
+
+    struct timespec reel;
+    clock_gettime(CLOCK_REALTIME, &reel);
+    EnTete* e = v.entete;
+    e->version = version;
+    e->tailleBloc = tailleBloc;
+    e->nbBlocs = taille / tailleBloc - 1;
+    e->debutReel = (int64_t)reel.tv_sec * 1000000000LL + reel.tv_nsec;
+    e->debutMonotone = now();
+    e->blocsEcrits = 0;
+    e->perdus = 0;
+    memcpy(e->magic, magic, sizeof(magic));
+
+    // Changements restés dans l'anneau depuis un enregistrement précédent
+    Anneau& a = anneau();
+    vider(a, nullptr);
+    a.perdus.store(0, std::memory_order_relaxed);
+
+    try {
+        v.running = true;
+        v.thread = std::thread(executerVidage);
+    }
+    catch (std::system_error& ex) {
+        v.running = false;
+        fermer(v);
+        erreur = string("Impossible de lancer le thread d\'enregistrement : ") + ex.what();
+        return false;
+    }
+    actif.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void EnregistreurBroches::stop() {
+    Vidage& v = vidage();
+    {
+        std::lock_guard<std::mutex> lock(v.mutex);
+        if (!v.running)
+            return;
+        actif.store(false, std::memory_order_relaxed);
+        v.running = false;
+    }
+    v.condition.notify_all();
+    v.thread.join();
+
+    std::lock_guard<std::mutex> lock(v.mutex);
+    vider(anneau(), &v);
+    fermer(v);
+}
+
+uint64_t EnregistreurBroches::getDropped() {
+    return anneau().perdus.load(std::memory_order_relaxed);
+}
+
+void EnregistreurBroches::ajouterEcriture(int pin, bool high, uint64_t date) {
+    Anneau& a = anneau();
+    uint64_t pos;
+    if (pin < 0 || pin > brocheMax || !reserver(a, 1, pos)) {
+        a.perdus.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    deposer(a, pos, date, pin, high);
+}
+
+void EnregistreurBroches::ajouterSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n,
+                                          uint64_t debut, uint64_t fin) {
+    // Broches enregistrables du groupe
+    uint32_t broches = 0;
+    for (size_t b=0; b<count; b++)
+        if (nums[b] >= 0 && nums[b] <= brocheMax)
+            broches |= 1u << b;
+    size_t total = 0;
+    for (size_t i=0; i<n; i++)
+        total += __builtin_popcount((steps[i].setMask | steps[i].clearMask) & broches);
+
+    Anneau& a = anneau();
+    uint64_t pos;
+    if (!reserver(a, total, pos)) {
+        a.perdus.fetch_add(total, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t duree = fin - debut;
+    for (size_t i=0; i<n; i++) {
+        uint64_t date = debut + duree * i / n;
+        uint32_t setMask = steps[i].setMask & broches;
+        for (uint32_t m = (setMask | steps[i].clearMask) & broches; m != 0; m &= m - 1) {
+            int b = __builtin_ctz(m);
+            deposer(a, pos++, date, nums[b], (setMask >> b) & 1);
+        }
+    }
+}
+
+bool EnregistreurBroches::exportVCD(const string& fichier, ostream& os, string& erreur) {
+    int fd = ::open(fichier.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        erreur = "Impossible d\'ouvrir " + fichier + " : " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < 2 * tailleBloc) {
+        ::close(fd);
+        erreur = fichier + " n\'est pas un fichier d\'enregistrement";
+        return false;
+    }
+    void* carte = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (carte == MAP_FAILED) {
+        erreur = "Impossible de projeter " + fichier + " : " + strerror(errno);
+        return false;
+    }
+
+    const EnTete* e = static_cast<const EnTete*>(carte);
+    if (memcmp(e->magic, magic, sizeof(magic)) != 0 || e->version != version || e->tailleBloc != tailleBloc ||
+        (e->nbBlocs + 1) * tailleBloc != (uint64_t)st.st_size) {
+        munmap(carte, st.st_size);
+        erreur = fichier + " n\'est pas un fichier d\'enregistrement valide";
+        return false;
+    }
+
+    struct Changement {
+        uint64_t date;
+        int broche;
+        bool niveau;
+    };
+    vector<Changement> changements;
+    const uint64_t* donnees = reinterpret_cast<const uint64_t*>(static_cast<const uint8_t*>(carte) + tailleBloc);
+    uint64_t premier = e->blocsEcrits > e->nbBlocs ? e->blocsEcrits - e->nbBlocs : 0;
+    for (uint64_t b = premier; b < e->blocsEcrits; b++) {
+        const uint64_t* bloc = donnees + (b % e->nbBlocs) * motsParBloc;
+        for (size_t i=1; i<motsParBloc; i++) {
+            uint64_t mot = bloc[i];
+            if ((mot & motUtilise) == 0)
+                continue;
+            int64_t ecart = (int64_t)(mot << 16) >> 16;
+            changements.push_back({bloc[0] + ecart, (int)((mot >> 48) & brocheMax), ((mot >> 62) & 1) != 0});
+        }
+    }
+    uint64_t perdus = e->perdus;
+    int64_t debutReel = e->debutReel;
+    munmap(carte, st.st_size);
+
+    // Les producteurs ne déposent pas leurs changements dans l'ordre exact
+    // des dates
+    std::stable_sort(changements.begin(), changements.end(),
+                     [](const Changement& a, const Changement& b) { return a.date < b.date; });
+
+    map<int, string> identifiants;
+    for (const Changement& c : changements)
+        identifiants.emplace(c.broche, "");
+    size_t n = 0;
+    for (auto& i : identifiants)
+        i.second = identifiant(n++);
+
+    time_t secondes = debutReel / 1000000000LL;
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&secondes));
+    os << "$date " << date << " $end" << endl;
+    os << "$version Afficheur7seg EnregistreurBroches " << version << " $end" << endl;
+    os << "$comment " << changements.size() << " changements, " << perdus << " perdus $end" << endl;
+    os << "$timescale 1ns $end" << endl;
+    os << "$scope module afficheur $end" << endl;
+    for (const auto& i : identifiants)
+        os << "$var wire 1 " << i.second << " gpio" << i.first << " $end" << endl;
+    os << "$upscope $end" << endl;
+    os << "$enddefinitions $end" << endl;
+
+    os << "#0" << endl << "$dumpvars" << endl;
+    for (const auto& i : identifiants)
+        os << "x" << i.second << endl;
+    os << "$end" << endl;
+
+    // Seuls les vrais changements de niveau sont écrits
+    map<int, int> niveaux;
+    uint64_t origine = changements.empty() ? 0 : changements.front().date;
+    uint64_t derniere = 0;
+    for (const Changement& c : changements) {
+        auto niveau = niveaux.find(c.broche);
+        if (niveau != niveaux.end() && niveau->second == c.niveau)
+            continue;
+        niveaux[c.broche] = c.niveau;
+        uint64_t t = c.date - origine;
+        if (t != derniere)
+            os << "#" << t << "\n";
+        derniere = t;
+        os << (c.niveau ? '1' : '0') << identifiants[c.broche] << "\n";
+    }
+    os.flush();
+    if (!os) {
+        erreur = "Impossible d\'écrire le fichier VCD";
+        return false;
+    }
+    return true;
+}
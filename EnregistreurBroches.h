@@ -0,0 +1,116 @@
+/*
+ * File:   EnregistreurBroches.h
+ * Author: olivier
+ *
+ * Enregistreur facultatif des changements d'état des broches en sortie
+ * (CGPIO et CGPIOPort), datés par l'horloge monotone, pour comprendre ce
+ * qui s'est passé sur un panneau qui affiche n'importe quoi sur le
+ * terrain.
+ *
+ * Comme l'instrumentation, il est désactivé par défaut (un test d'un
+ * booléen atomique par écriture) et assez léger pour rester actif en
+ * production :
+ * - les écritures sont déposées dans un anneau en mémoire sans verrou
+ *   (plusieurs producteurs : le thread qui envoie les trames et celui du
+ *   moteur de luminosité), une séquence entière est réservée par une
+ *   seule instruction atomique ; si l'anneau est plein les changements
+ *   sont perdus et comptés, l'écriture n'attend jamais ;
+ * - un thread dédié vide périodiquement l'anneau dans un fichier projeté
+ *   en mémoire : ce qui y est écrit survit à un arrêt brutal du
+ *   programme, seuls les changements encore dans l'anneau (au plus une
+ *   période de vidage) sont alors perdus.
+ *
+ * Le fichier a une taille fixe et il est réutilisé en boucle : il garde
+ * toujours les changements les plus récents. Il est découpé en blocs de
+ * 4 Kio dont le premier mot est une date de référence ; chacun des mots
+ * suivants (8 octets) décrit un changement : broche, niveau et écart à la
+ * date de référence. exportVCD() le convertit au format VCD, lisible par
+ * GTKWave (voir vcdAfficheur.cpp).
+ *
+ * Une séquence rejouée par CGPIOPort::writeSequence() est datée au début
+ * et à la fin de l'appel : les dates de ses étapes sont interpolées
+ * linéairement entre les deux. Toutes les broches des masques d'une étape
+ * sont enregistrées, même si leur niveau ne change pas (la conversion VCD
+ * ne garde que les changements).
+ */
+
+#ifndef ENREGISTREURBROCHES_H
+#define	ENREGISTREURBROCHES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <ctime>
+#include "GPIOBackend.h"
+
+using namespace std;
+
+class EnregistreurBroches {
+public:
+    // Nombre de changements que peut contenir l'anneau en mémoire
+    static const size_t capaciteAnneau = 1 << 16;
+    // Taille d'un bloc du fichier
+    static const size_t tailleBloc = 4096;
+    // Les broches de numéro supérieur ne peuvent être enregistrées
+    static const int brocheMax = 0x3FFF;
+
+    // Crée (ou remplace) le fichier 'fichier' de 'taille' octets (au moins
+    // deux blocs) et lance l'enregistrement, vidé dans le fichier à chaque
+    // période. Renvoie false (avec un message dans 'erreur') en cas de
+    // problème
+    static bool start(const string& fichier, size_t taille, std::chrono::milliseconds periode, string& erreur);
+    // Vide l'anneau une dernière fois et ferme le fichier
+    static void stop();
+
+    static bool isEnabled() {
+        return actif.load(std::memory_order_relaxed);
+    }
+
+    // Chemin critique : ne font rien si l'enregistrement est désactivé
+    static void recordWrite(int pin, bool high) {
+        if (isEnabled())
+            ajouterEcriture(pin, high, now());
+    }
+    static void recordStep(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask) {
+        if (isEnabled()) {
+            CGPIOStep step = {setMask, clearMask};
+            uint64_t date = now();
+            ajouterSequence(nums, count, &step, 1, date, date);
+        }
+    }
+    // Séquence rejouée entre les dates 'debut' et 'fin'
+    static void recordSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n,
+                               uint64_t debut, uint64_t fin) {
+        if (isEnabled())
+            ajouterSequence(nums, count, steps, n, debut, fin);
+    }
+
+    // Horloge monotone en nanosecondes
+    static uint64_t now() {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+    }
+
+    // Changements perdus (anneau plein) depuis le lancement
+    static uint64_t getDropped();
+
+    // Convertit un fichier d'enregistrement au format VCD (une variable
+    // 'gpioN' par broche, temps en nanosecondes depuis le premier
+    // changement). Renvoie false (avec un message dans 'erreur') si le
+    // fichier ne peut être lu
+    static bool exportVCD(const string& fichier, ostream& os, string& erreur);
+
+private:
+    static std::atomic<bool> actif;
+
+    static void ajouterEcriture(int pin, bool high, uint64_t date);
+    static void ajouterSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n,
+                                uint64_t debut, uint64_t fin);
+};
+
+#endif	/* ENREGISTREURBROCHES_H */
+
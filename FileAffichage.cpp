@@ -0,0 +1,174 @@
+/*
+ * File:   FileAffichage.cpp
+ * Author: olivier
+ */
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "FileAffichage.h"
+
+const int FileAffichage::nbEmplacements;
+
+FileAffichage::FileAffichage(PanneauAffichage& panneau, int cpu) : panneau(panneau) {
+    this->cpu = cpu;
+    for (Emplacement& e : this->emplacements)
+        e.octets.reset(new uint8_t[panneau.getNbAfficheurs()]);
+    this->dernier = -1;
+    this->luminosite = -1;
+    this->signale = false;
+    this->running = false;
+    this->remplacees = 0;
+    // Créé une fois pour toutes : un dépôt fait avant start() ou après
+    // stop() reste signalé et sera envoyé au prochain start()
+    this->eventFd = eventfd(0, EFD_CLOEXEC);
+    if (this->eventFd < 0)
+        throw (PanneauAffichage::Erreur(string("Impossible de créer l\'eventfd : ") + strerror(errno)));
+}
+
+FileAffichage::~FileAffichage() {
+    stop();
+    ::close(this->eventFd);
+}
+
+void FileAffichage::start() {
+    if (this->running)
+        return;
+
+    this->running = true;
+    this->thread = std::thread(&FileAffichage::run, this);
+
+    if (this->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(this->cpu, &cpus);
+        int err = pthread_setaffinity_np(this->thread.native_handle(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            stop();
+            throw (PanneauAffichage::Erreur(string("Impossible de fixer le thread d\'E/S : ") + strerror(err)));
+        }
+    }
+}
+
+void FileAffichage::stop() {
+    if (!this->running)
+        return;
+
+    // Les dépôts en attente sont envoyés avant l'arrêt
+    this->running = false;
+    uint64_t un = 1;
+    if (::write(this->eventFd, &un, sizeof(un)) < 0)
+        cerr << "FileAffichage : eventfd " << strerror(errno) << endl;
+    this->thread.join();
+}
+
+void FileAffichage::postFrame(const uint8_t* octets) {
+    int i = acquire();
+    if (i < 0)
+        return;
+    std::copy(octets, octets + this->panneau.getNbAfficheurs(), this->emplacements[i].octets.get());
+    publish(i);
+}
+
+void FileAffichage::postText(std::string_view text) {
+    int i = acquire();
+    if (i < 0)
+        return;
+    try {
+        this->panneau.encodeText(text, this->emplacements[i].octets.get());
+    }
+    catch (...) {
+        release(i);
+        throw;
+    }
+    publish(i);
+}
+
+void FileAffichage::postBrightness(int level) {
+    this->luminosite.store(std::min(std::max(level, 0), MoteurLuminosite::luminositeMax),
+                           std::memory_order_release);
+    wake();
+}
+
+uint64_t FileAffichage::getDroppedFrames() const {
+    return this->remplacees.load(std::memory_order_relaxed);
+}
+
+int FileAffichage::acquire() {
+    // Un seul passage, sans attente : il y a toujours un emplacement libre
+    // tant que moins de nbEmplacements - 2 producteurs déposent en même temps
+    for (int i=0; i<nbEmplacements; i++) {
+        bool libre = false;
+        if (this->emplacements[i].occupe.compare_exchange_strong(libre, true, std::memory_order_acquire))
+            return i;
+    }
+    // Sinon la trame publiée et pas encore envoyée, qui serait de toute façon
+    // remplacée, est reprise
+    int i = this->dernier.exchange(-1, std::memory_order_acq_rel);
+    this->remplacees.fetch_add(1, std::memory_order_relaxed);
+    return i;
+}
+
+void FileAffichage::release(int i) {
+    this->emplacements[i].occupe.store(false, std::memory_order_release);
+}
+
+void FileAffichage::publish(int i) {
+    int precedent = this->dernier.exchange(i, std::memory_order_acq_rel);
+    if (precedent >= 0) {
+        release(precedent);
+        this->remplacees.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake();
+}
+
+void FileAffichage::wake() {
+    // Un seul appel système tant que le thread d'E/S n'a pas consommé le signal
+    if (this->signale.exchange(true, std::memory_order_acq_rel))
+        return;
+    uint64_t un = 1;
+    if (::write(this->eventFd, &un, sizeof(un)) < 0)
+        cerr << "FileAffichage : eventfd " << strerror(errno) << endl;
+}
+
+void FileAffichage::run() {
+    for (;;) {
+        uint64_t compteur;
+        if (::read(this->eventFd, &compteur, sizeof(compteur)) < 0 && errno != EINTR) {
+            cerr << "FileAffichage : eventfd " << strerror(errno) << endl;
+            return;
+        }
+        // Remis à zéro avant de consommer : un dépôt ultérieur réveillera
+        // de nouveau le thread
+        this->signale.store(false, std::memory_order_release);
+        bool arret = !this->running;
+
+        int i = this->dernier.exchange(-1, std::memory_order_acq_rel);
+        if (i >= 0) {
+            try {
+                this->panneau.displayFrame(this->emplacements[i].octets.get());
+            }
+            catch (PanneauAffichage::Erreur& e) {
+                cerr << e.what() << endl;
+            }
+            release(i);
+        }
+
+        int level = this->luminosite.exchange(-1, std::memory_order_acq_rel);
+        if (level >= 0) {
+            try {
+                this->panneau.setBrightness(level);
+            }
+            catch (PanneauAffichage::Erreur& e) {
+                cerr << e.what() << endl;
+            }
+        }
+
+        if (arret)
+            return;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * File:   FileAffichage.h
+ * Author: olivier
+ *
+ * File de commandes devant un panneau : n'importe quel thread dépose une
+ * trame, un texte, un nombre ou une luminosité sans jamais attendre les
+ * E/S. Un thread d'E/S dédié (éventuellement fixé sur un coeur) est le
+ * seul à appeler le panneau.
+ *
+ * Seule la dernière valeur compte : une trame déposée remplace celle qui
+ * n'a pas encore été envoyée. Les trames sont échangées par un ensemble
+ * d'emplacements sans verrou (généralisation du triple tampon à plusieurs
+ * producteurs) :
+ * - un producteur réserve un emplacement libre, y écrit sa trame puis
+ *   l'échange atomiquement avec 'dernier' ; l'emplacement qu'il récupère
+ *   (trame jamais envoyée) est libéré ;
+ * - le thread d'E/S récupère 'dernier' de la même manière, envoie la
+ *   trame puis libère l'emplacement.
+ * Le thread d'E/S est réveillé par un eventfd, écrit seulement s'il n'a
+ * pas déjà été signalé.
+ */
+
+#ifndef FILEAFFICHAGE_H
+#define	FILEAFFICHAGE_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <string_view>
+#include "PanneauAffichage.h"
+
+class FileAffichage {
+public:
+    // cpu : coeur sur lequel fixer le thread d'E/S (-1 : aucun). Lève une
+    // exception PanneauAffichage::Erreur si l'eventfd ne peut être créé
+    FileAffichage(PanneauAffichage& panneau, int cpu = -1);
+    virtual ~FileAffichage();
+
+    // Lancement et arrêt du thread d'E/S (le panneau doit être initialisé).
+    // Lèvent une exception PanneauAffichage::Erreur en cas de problème. Les
+    // dépôts faits pendant l'arrêt sont envoyés au lancement suivant
+    void start();
+    void stop();
+
+    // Dépôts sans attente, depuis n'importe quel thread. La conversion est
+    // faite par l'appelant : un texte ou un nombre non affichable lève
+    // immédiatement une exception PanneauAffichage::Erreur. Si tous les
+    // emplacements sont pris par des dépôts simultanés, le dépôt est
+    // abandonné (une des trames en cours de dépôt le remplace) et compté
+    // par getDroppedFrames()
+    void postFrame(const uint8_t* octets);
+    void postText(std::string_view text);
+    template<typename T>
+    void postNumber(T value, const FormatNombre& format = FormatNombre()) {
+        int i = acquire();
+        if (i < 0)
+            return;
+        try {
+            this->panneau.encodeNumber(value, this->emplacements[i].octets.get(), format);
+        }
+        catch (...) {
+            release(i);
+            throw;
+        }
+        publish(i);
+    }
+    void postBrightness(int level);
+
+    // Nombre de trames remplacées (ou abandonnées) avant d'avoir été envoyées
+    uint64_t getDroppedFrames() const;
+
+private:
+    // Emplacements : un par producteur simultané, plus celui publié et
+    // celui en cours d'envoi
+    static const int nbEmplacements = 8;
+
+    struct Emplacement {
+        std::atomic<bool> occupe{false};
+        std::unique_ptr<uint8_t[]> octets;
+    };
+
+    PanneauAffichage& panneau;
+    int cpu;
+    Emplacement emplacements[nbEmplacements];
+    // Emplacement publié et pas encore envoyé (-1 : aucun)
+    std::atomic<int> dernier;
+    // Luminosité demandée et pas encore appliquée (-1 : aucune)
+    std::atomic<int> luminosite;
+    std::atomic<bool> signale;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> remplacees;
+    int eventFd;
+    std::thread thread;
+
+    // Emplacement réservé, -1 si aucun n'est disponible (le dépôt est
+    // alors compté comme remplacé)
+    int acquire();
+    void release(int i);
+    void publish(int i);
+    void wake();
+    void run();
+};
+
+#endif	/* FILEAFFICHAGE_H */
+
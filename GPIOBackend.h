@@ -0,0 +1,230 @@
+/**
+\file GPIOBackend.h
+Déclaration de l'interface CGPIOBackend
+\class CGPIOBackend
+\brief Interface des méthodes d'accès matériel utilisées par la classe CGPIO
+
+La classe CGPIO ne dialogue plus directement avec le noyau : toutes les opérations sur une broche
+(exportation, direction, écriture et lecture du niveau logique) passent par un objet qui implémente
+cette interface. Il est ainsi possible de choisir la méthode d'accès la mieux adaptée à la carte :
+- CGPIOSysfsBackend : pseudo système de fichiers 'sysfs' (/sys/class/gpio), portable mais lent ;
+- CGPIOMmapBackend : accès direct aux registres GPIO projetés en mémoire (/dev/gpiomem), trés rapide.
+
+Comme pour la classe CGPIO, les méthodes renvoient un booléen qui indique si l'action demandée
+a réussi ou échoué, la description de l'erreur est obtenue par getLastError(). Les méthodes
+writeValue() et readValue() sont appelées pour chaque changement d'état d'une broche, elles
+ne vérifient donc rien pour être le plus rapide possible.
+
+Les méthodes d'accés qui le peuvent signalent aussi les fronts des broches en entrée
+(setEdge(), getEdgeFd(), readEdges()), exploités par la classe CGPIOEventLoop.
+*/
+
+#ifndef GPIO_BACKEND_H
+#define GPIO_BACKEND_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+/**
+* \struct CGPIOStep
+* \brief Une étape d'une séquence d'écritures : broches à mettre à l'état haut et à l'état bas
+*
+* Le bit i de chaque masque désigne la i-ème broche du tableau passé à CGPIOBackend::writeSequence().
+*/
+struct CGPIOStep {
+	uint32_t setMask;	///< Broches à mettre à l'état haut
+	uint32_t clearMask;	///< Broches à mettre à l'état bas
+};
+
+/**
+* \enum CGPIOEdge
+* Fronts signalés par une broche en entrée (voir CGPIOBackend::setEdge())
+*/
+enum class CGPIOEdge : uint8_t {
+	NONE,		///< Aucun front signalé
+	RISING,		///< Fronts montants
+	FALLING,	///< Fronts descendants
+	BOTH		///< Fronts montants et descendants
+};
+
+/**
+* \struct CGPIOEvent
+* \brief Un changement d'état détecté sur une broche en entrée
+*/
+struct CGPIOEvent {
+	int num;		///< Numéro de la broche
+	bool high;		///< Niveau de la broche après le front
+	uint64_t timestamp;	///< Date du front en nanosecondes (CLOCK_MONOTONIC)
+};
+
+class CGPIOBackend
+{
+public:
+	virtual ~CGPIOBackend() {}
+
+	/**
+	* \brief Rend la broche accessible (export sysfs, vérification du numéro pour les registres...)
+	* \param[in] num Numéro de la broche
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool exportPin(int num) = 0;
+
+	/**
+	* \brief Réserve en une seule opération un groupe de broches utilisées ensemble
+	*
+	* Cette méthode est facultative : les broches sont ensuite initialisées normalement par exportPin(),
+	* setDirection()... Les méthodes d'accés qui savent manipuler plusieurs broches à la fois
+	* (CGPIOCdevBackend) en profitent pour préparer le groupe, les autres ne font rien.
+	* \param[in] nums Numéros des broches
+	* \param[in] count Nombre de broches (32 au maximum)
+	* \param[in] output true si les broches sont destinées à être des sorties
+	* \param[in] highMask Sorties à mettre à l'état haut dès la réservation (bit i pour nums[i]), les autres
+	* sont à l'état bas
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool requestPins(const int* nums, size_t count, bool output, uint32_t highMask = 0) { return true; }
+
+	/**
+	* \brief Libère la broche exportée par exportPin()
+	* \param[in] num Numéro de la broche
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool unexportPin(int num) = 0;
+
+	/**
+	* \brief Fixe le sens de la broche
+	* \param[in] num Numéro de la broche
+	* \param[in] output true pour une sortie, false pour une entrée
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool setDirection(int num, bool output) = 0;
+
+	/**
+	* \brief Prépare l'accés au niveau logique de la broche (ouverture du fichier 'value' en sysfs)
+	* \param[in] num Numéro de la broche
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool openValue(int num) = 0;
+
+	/**
+	* \brief Termine l'accés au niveau logique ouvert par openValue()
+	* \param[in] num Numéro de la broche
+	*/
+	virtual void closeValue(int num) = 0;
+
+	/**
+	* \brief Fixe le niveau logique d'une broche en sortie, aucune vérification n'est faite
+	* \param[in] num Numéro de la broche
+	* \param[in] high true pour un niveau haut, false pour un niveau bas
+	*/
+	virtual void writeValue(int num, bool high) = 0;
+
+	/**
+	* \brief Fixe en une seule opération le niveau logique de plusieurs broches en sortie
+	*
+	* Le bit i de setMask (respectivement clearMask) met la broche nums[i] à l'état haut (respectivement bas),
+	* les broches dont le bit est à 0 dans les deux masques ne sont pas modifiées. Par défaut la méthode
+	* appelle writeValue() pour chaque broche concernée.
+	* \param[in] nums Numéros des broches
+	* \param[in] count Nombre de broches (32 au maximum)
+	* \param[in] setMask Broches à mettre à l'état haut
+	* \param[in] clearMask Broches à mettre à l'état bas
+	*/
+	virtual void writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask);
+
+	/**
+	* \brief Rejoue une séquence d'écritures précalculée sur un groupe de broches
+	*
+	* Chaque étape est équivalente à un appel de writeValues(), la séquence est rejouée d'une traite.
+	* Par défaut la méthode appelle writeValues() pour chaque étape, les méthodes d'accés qui le peuvent
+	* (registres projetés) la redéfinissent pour ne pas payer un appel virtuel par étape.
+	* \param[in] nums Numéros des broches
+	* \param[in] count Nombre de broches (32 au maximum)
+	* \param[in] steps Etapes de la séquence
+	* \param[in] n Nombre d'étapes
+	*/
+	virtual void writeSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n);
+
+	/**
+	* \brief Lit le niveau logique d'une broche
+	* \param[in] num Numéro de la broche
+	* \param[out] high true si la broche est au niveau haut
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool readValue(int num, bool& high) = 0;
+
+	/**
+	* \brief Choisit les fronts signalés par une broche en entrée
+	*
+	* Par défaut la méthode d'accés ne sait pas signaler les fronts et la méthode échoue.
+	* \param[in] num Numéro de la broche
+	* \param[in] edge Fronts à signaler (CGPIOEdge::NONE pour ne plus rien signaler)
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool setEdge(int num, CGPIOEdge edge);
+
+	/**
+	* \brief Renvoie le descripteur à surveiller (poll, epoll) pour être prévenu des fronts d'une broche
+	*
+	* Plusieurs broches peuvent partager le même descripteur (lignes d'une même requête cdev).
+	* \param[in] num Numéro de la broche
+	* \param[out] events Evénements à surveiller sur le descripteur (EPOLLPRI, EPOLLIN...)
+	* \return le descripteur, -1 si la broche ne peut pas signaler ses fronts
+	*/
+	virtual int getEdgeFd(int num, uint32_t& events) { return -1; }
+
+	/**
+	* \brief Lit les fronts en attente sur un descripteur renvoyé par getEdgeFd()
+	*
+	* A appeler quand le descripteur est signalé, la lecture réarme la détection.
+	* \param[in] fd Descripteur signalé
+	* \param[out] events Fronts lus
+	* \param[in] max Nombre maximal de fronts à lire
+	* \return le nombre de fronts lus, -1 en cas d'erreur
+	*/
+	virtual int readEdges(int fd, CGPIOEvent* events, int max) { return -1; }
+
+	/**
+	* \brief Renvoie le dernier message d'erreur puis le réinitialise
+	* \return une chaine de caractère (string) qui contient le message d'erreur
+	*/
+	string getLastError();
+
+protected:
+	/// cette chaine contient le dernier message d'erreur
+	string error;
+};
+
+inline void CGPIOBackend::writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (setMask & (1u << i))
+			writeValue(nums[i], true);
+		else if (clearMask & (1u << i))
+			writeValue(nums[i], false);
+	}
+}
+
+inline void CGPIOBackend::writeSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		writeValues(nums, count, steps[i].setMask, steps[i].clearMask);
+}
+
+inline bool CGPIOBackend::setEdge(int num, CGPIOEdge edge)
+{
+	error = "OPERATION FAILED: Edge detection is not supported for GPIO " + to_string(num);
+	return false;
+}
+
+inline string CGPIOBackend::getLastError()
+{
+	string temp = this->error;
+	this->error = "No error \n";
+	return temp;
+}
+
+#endif
@@ -0,0 +1,369 @@
+/**
+\file GPIOCdevBackend.cpp
+
+\brief Implémentation de la classe CGPIOCdevBackend (accés aux broches par /dev/gpiochipN)
+*/
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/gpio.h>
+
+#include "GPIOCdevBackend.h"
+
+using namespace std;
+
+CGPIOCdevBackend::CGPIOCdevBackend(const string& chipPath)
+{
+	this->chipPath = chipPath;
+	this->chipFd = -1;
+}
+
+CGPIOCdevBackend::~CGPIOCdevBackend()
+{
+	for (auto& g : groups)
+		::close(g.fd);
+	if (chipFd >= 0)
+		::close(chipFd);
+}
+
+bool CGPIOCdevBackend::openChip()
+{
+	if (chipFd >= 0)
+		return true;
+
+	chipFd = ::open(chipPath.c_str(), O_RDWR | O_CLOEXEC);
+	if (chipFd < 0) {
+		error = "OPERATION FAILED: Unable to open " + chipPath + " : " + strerror(errno) + "\n";
+		return false;
+	}
+	return true;
+}
+
+const CGPIOCdevBackend::LineRef* CGPIOCdevBackend::find(int num) const
+{
+	if (num < 0 || (size_t)num >= lines.size() || lines[num].group < 0)
+		return nullptr;
+	return &lines[num];
+}
+
+bool CGPIOCdevBackend::requestGroup(const int* nums, size_t count, bool output, uint64_t highMask)
+{
+	if (count == 0 || count > GPIO_V2_LINES_MAX) {
+		error = "OPERATION FAILED: Invalid number of GPIO lines in a request";
+		return false;
+	}
+	if (!openChip())
+		return false;
+
+	struct gpio_v2_line_request req;
+	memset(&req, 0, sizeof(req));
+	for (size_t i = 0; i < count; i++) {
+		if (find(nums[i]) != nullptr) {
+			error = "OPERATION FAILED: GPIO " + to_string(nums[i]) + " is already requested";
+			return false;
+		}
+		req.offsets[i] = nums[i];
+	}
+	req.num_lines = count;
+	strncpy(req.consumer, "afficheur7seg", sizeof(req.consumer) - 1);
+
+	uint64_t all = (count == 64) ? ~0ull : ((1ull << count) - 1);
+	if (output) {
+		// Les sorties démarrent directement à leur niveau initial : une broche
+		// OE (active à l'état bas) n'active jamais le panneau, même brièvement
+		req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+		req.config.num_attrs = 1;
+		req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		req.config.attrs[0].attr.values = highMask & all;
+		req.config.attrs[0].mask = all;
+	}
+	else
+		req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+
+	if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+		error = "OPERATION FAILED: Unable to request GPIO " + to_string(nums[0]) +
+			(count > 1 ? " and following" : "") + " : " + strerror(errno) + "\n";
+		return false;
+	}
+
+	LineGroup g;
+	g.fd = req.fd;
+	g.offsets.assign(nums, nums + count);
+	g.outputMask = output ? all : 0;
+	g.values = output ? (highMask & all) : 0;
+	// Une ligne n'est comptée comme utilisée qu'une fois passée par exportPin() :
+	// si l'initialisation d'un port échoue, les broches rendues libèrent le groupe
+	g.exported = 0;
+	g.risingMask = 0;
+	g.fallingMask = 0;
+	groups.push_back(g);
+
+	for (size_t i = 0; i < count; i++) {
+		if ((size_t)nums[i] >= lines.size())
+			lines.resize(nums[i] + 1, LineRef{-1, 0});
+		lines[nums[i]] = LineRef{(int)groups.size() - 1, (int)i};
+	}
+	return true;
+}
+
+bool CGPIOCdevBackend::applyConfig(LineGroup& g)
+{
+	struct gpio_v2_line_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.flags = GPIO_V2_LINE_FLAG_INPUT;
+	if (g.outputMask != 0) {
+		cfg.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+		cfg.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+		cfg.attrs[0].mask = g.outputMask;
+		cfg.attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		cfg.attrs[1].attr.values = g.values;
+		cfg.attrs[1].mask = g.outputMask;
+		cfg.num_attrs = 2;
+	}
+
+	// Détection des fronts des entrées : un attribut par combinaison de fronts
+	uint64_t inputs = ~g.outputMask;
+	const struct {
+		uint64_t mask;
+		uint64_t flags;
+	} edges[] = {
+		{g.risingMask & ~g.fallingMask & inputs, GPIO_V2_LINE_FLAG_EDGE_RISING},
+		{g.fallingMask & ~g.risingMask & inputs, GPIO_V2_LINE_FLAG_EDGE_FALLING},
+		{g.risingMask & g.fallingMask & inputs, GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING},
+	};
+	for (const auto& e : edges) {
+		if (e.mask == 0)
+			continue;
+		cfg.attrs[cfg.num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+		cfg.attrs[cfg.num_attrs].attr.flags = GPIO_V2_LINE_FLAG_INPUT | e.flags;
+		cfg.attrs[cfg.num_attrs].mask = e.mask;
+		cfg.num_attrs++;
+	}
+
+	if (ioctl(g.fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cfg) < 0) {
+		error = "OPERATION FAILED: Unable to configure GPIO " + to_string(g.offsets[0]) +
+			" : " + strerror(errno) + "\n";
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOCdevBackend::exportPin(int num)
+{
+	// Broche déjà réservée par requestPins() : elle est simplement marquée comme
+	// utilisée. Sinon elle forme son propre groupe, en entrée
+	const LineRef* ref = find(num);
+	if (ref == nullptr) {
+		if (!requestGroup(&num, 1, false, 0))
+			return false;
+		ref = find(num);
+	}
+	groups[ref->group].exported |= 1ull << ref->bit;
+	return true;
+}
+
+bool CGPIOCdevBackend::requestPins(const int* nums, size_t count, bool output, uint32_t highMask)
+{
+	size_t known = 0;
+	for (size_t i = 0; i < count; i++)
+		if (find(nums[i]) != nullptr)
+			known++;
+
+	if (known == count)
+		return true;
+	return requestGroup(nums, count, output, highMask);
+}
+
+bool CGPIOCdevBackend::unexportPin(int num)
+{
+	const LineRef* ref = find(num);
+	if (ref == nullptr) {
+		error = "OPERATION FAILED: Unable to unexport GPIO " + to_string(num) + " : not requested";
+		return false;
+	}
+
+	// Une requête ne peut être libérée qu'en entier : on attend que toutes ses lignes soient rendues
+	int group = ref->group;
+	LineGroup& g = groups[group];
+	g.exported &= ~(1ull << ref->bit);
+	if (g.exported == 0) {
+		// Le groupe est supprimé (des cycles init()/close() répétés ne font pas
+		// grossir la liste) : les groupes suivants reculent d'un rang
+		::close(g.fd);
+		for (int off : g.offsets)
+			lines[off].group = -1;
+		groups.erase(groups.begin() + group);
+		for (LineRef& l : lines)
+			if (l.group > group)
+				l.group--;
+	}
+	return true;
+}
+
+bool CGPIOCdevBackend::setDirection(int num, bool output)
+{
+	const LineRef* ref = find(num);
+	if (ref == nullptr) {
+		error =  "OPERATION FAILED: Unable to set direction of GPIO " + to_string(num) + " : not requested";
+		return false;
+	}
+
+	LineGroup& g = groups[ref->group];
+	uint64_t bit = 1ull << ref->bit;
+	uint64_t mask = output ? (g.outputMask | bit) : (g.outputMask & ~bit);
+	if (mask == g.outputMask)
+		return true;
+
+	uint64_t previous = g.outputMask;
+	g.outputMask = mask;
+	if (!applyConfig(g)) {
+		g.outputMask = previous;
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOCdevBackend::openValue(int num)
+{
+	if (find(num) == nullptr) {
+		error = "OPERATION FAILED: Unable to set the value of GPIO " + to_string(num) + " : not requested";
+		return false;
+	}
+	return true;
+}
+
+void CGPIOCdevBackend::closeValue(int num)
+{
+}
+
+void CGPIOCdevBackend::writeValue(int num, bool high)
+{
+	const LineRef& ref = lines[num];
+	LineGroup& g = groups[ref.group];
+	uint64_t bit = 1ull << ref.bit;
+
+	struct gpio_v2_line_values v;
+	v.mask = bit;
+	v.bits = high ? bit : 0;
+	ioctl(g.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v);
+	g.values = high ? (g.values | bit) : (g.values & ~bit);
+}
+
+void CGPIOCdevBackend::writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask)
+{
+	if (count == 0)
+		return;
+
+	// Toutes les broches du groupe de la première broche sont modifiées par un seul ioctl,
+	// les éventuelles broches d'autres groupes sont traitées une par une
+	int group = lines[nums[0]].group;
+	struct gpio_v2_line_values v;
+	v.mask = 0;
+	v.bits = 0;
+	for (size_t i = 0; i < count; i++) {
+		bool set = setMask & (1u << i);
+		if (!set && !(clearMask & (1u << i)))
+			continue;
+		const LineRef& ref = lines[nums[i]];
+		if (ref.group != group) {
+			writeValue(nums[i], set);
+			continue;
+		}
+		v.mask |= 1ull << ref.bit;
+		if (set)
+			v.bits |= 1ull << ref.bit;
+	}
+
+	if (v.mask == 0)
+		return;
+	LineGroup& g = groups[group];
+	ioctl(g.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v);
+	g.values = (g.values & ~v.mask) | v.bits;
+}
+
+bool CGPIOCdevBackend::readValue(int num, bool& high)
+{
+	const LineRef* ref = find(num);
+	if (ref == nullptr) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " is not requested";
+		return false;
+	}
+
+	struct gpio_v2_line_values v;
+	v.mask = 1ull << ref->bit;
+	v.bits = 0;
+	if (ioctl(groups[ref->group].fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &v) < 0) {
+		error = "OPERATION FAILED: Unable to read GPIO " + to_string(num) + " : " + strerror(errno) + "\n";
+		return false;
+	}
+	high = (v.bits & v.mask) != 0;
+	return true;
+}
+
+bool CGPIOCdevBackend::setEdge(int num, CGPIOEdge edge)
+{
+	const LineRef* ref = find(num);
+	if (ref == nullptr) {
+		error = "OPERATION FAILED: Unable to set edge of GPIO " + to_string(num) + " : not requested";
+		return false;
+	}
+
+	LineGroup& g = groups[ref->group];
+	uint64_t bit = 1ull << ref->bit;
+	uint64_t rising = g.risingMask & ~bit;
+	uint64_t falling = g.fallingMask & ~bit;
+	if (edge == CGPIOEdge::RISING || edge == CGPIOEdge::BOTH)
+		rising |= bit;
+	if (edge == CGPIOEdge::FALLING || edge == CGPIOEdge::BOTH)
+		falling |= bit;
+	if (rising == g.risingMask && falling == g.fallingMask)
+		return true;
+
+	uint64_t previousRising = g.risingMask;
+	uint64_t previousFalling = g.fallingMask;
+	g.risingMask = rising;
+	g.fallingMask = falling;
+	if (!applyConfig(g)) {
+		g.risingMask = previousRising;
+		g.fallingMask = previousFalling;
+		return false;
+	}
+	return true;
+}
+
+int CGPIOCdevBackend::getEdgeFd(int num, uint32_t& events)
+{
+	const LineRef* ref = find(num);
+	if (ref == nullptr)
+		return -1;
+	events = EPOLLIN;
+	return groups[ref->group].fd;
+}
+
+int CGPIOCdevBackend::readEdges(int fd, CGPIOEvent* events, int max)
+{
+	// Au plus 16 événements par lecture, le noyau en garde d'autres en attente
+	struct gpio_v2_line_event raw[16];
+	int n = std::min(max, 16);
+	if (n < 1)
+		return 0;
+
+	ssize_t size = ::read(fd, raw, n * sizeof(raw[0]));
+	if (size < 0) {
+		error = string("OPERATION FAILED: Unable to read GPIO events : ") + strerror(errno) + "\n";
+		return -1;
+	}
+
+	n = size / sizeof(raw[0]);
+	for (int i = 0; i < n; i++) {
+		events[i].num = raw[i].offset;
+		events[i].high = (raw[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+		events[i].timestamp = raw[i].timestamp_ns;
+	}
+	return n;
+}
@@ -0,0 +1,89 @@
+/**
+\file GPIOCdevBackend.h
+Déclaration de la classe CGPIOCdevBackend
+\class CGPIOCdevBackend
+\brief Accés aux broches E/S TOR par le périphérique caractère GPIO (interface uAPI v2 du noyau)
+
+L'interface sysfs est obsolète depuis le noyau 4.8 : elle est remplacée par les périphériques
+/dev/gpiochipN pilotés par ioctl(). Les broches sont désignées par leur numéro de ligne (offset)
+sur la puce choisie au constructeur et sont réservées par des "requêtes de lignes" : une requête
+peut regrouper jusqu'à 64 lignes dont les niveaux sont fixés par un seul appel GPIO_V2_LINE_SET_VALUES.
+
+La méthode requestPins() permet donc de réserver en une seule opération toutes les broches d'un
+panneau (OE, LE, DATA, CLK) : writeValues() modifie ensuite plusieurs broches du groupe en un seul
+appel système. Une broche initialisée seule par exportPin() forme son propre groupe. Les sorties
+sont réservées directement avec leur niveau initial (OE à l'état haut), sans passer par l'état bas.
+Une ligne du groupe n'est comptée comme utilisée qu'après exportPin() : le groupe est supprimé dès
+que toutes les lignes utilisées sont libérées.
+
+Les fronts des lignes en entrée sont signalés par le descripteur de leur requête, datés par le
+noyau : ils sont lus par readEdges() sous forme d'événements gpio_v2_line_event.
+
+Le chemin de la puce est paramétrable, ce qui permet d'utiliser les puces simulées des modules
+noyau gpio-sim ou gpio-mockup sur un PC Linux classique.
+*/
+
+#ifndef GPIO_CDEV_BACKEND_H
+#define GPIO_CDEV_BACKEND_H
+
+#include <cstdint>
+#include <vector>
+#include "GPIOBackend.h"
+
+class CGPIOCdevBackend : public CGPIOBackend
+{
+public:
+	/**
+	* \brief Constructeur de la classe CGPIOCdevBackend
+	* \param[in] chipPath Chemin du périphérique de la puce GPIO (par défaut /dev/gpiochip0)
+	*/
+	CGPIOCdevBackend(const string& chipPath = "/dev/gpiochip0");
+	virtual ~CGPIOCdevBackend();
+
+	virtual bool exportPin(int num);
+	virtual bool requestPins(const int* nums, size_t count, bool output, uint32_t highMask = 0);
+	virtual bool unexportPin(int num);
+	virtual bool setDirection(int num, bool output);
+	virtual bool openValue(int num);
+	virtual void closeValue(int num);
+	virtual void writeValue(int num, bool high);
+	virtual void writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask);
+	virtual bool readValue(int num, bool& high);
+	virtual bool setEdge(int num, CGPIOEdge edge);
+	virtual int getEdgeFd(int num, uint32_t& events);
+	virtual int readEdges(int fd, CGPIOEvent* events, int max);
+
+private:
+	/// Un groupe de lignes réservées par une même requête
+	struct LineGroup {
+		int fd;                 ///< descripteur de la requête
+		vector<int> offsets;    ///< lignes du groupe, dans l'ordre de la requête
+		uint64_t outputMask;    ///< lignes du groupe configurées en sortie
+		uint64_t values;        ///< derniers niveaux écrits sur les sorties
+		uint64_t exported;      ///< lignes passées par exportPin() et encore utilisées (le groupe est libéré quand il n'en reste plus)
+		uint64_t risingMask;    ///< lignes en entrée qui signalent leurs fronts montants
+		uint64_t fallingMask;   ///< lignes en entrée qui signalent leurs fronts descendants
+	};
+
+	/// Position d'une ligne : index du groupe et rang de la ligne dans ce groupe
+	struct LineRef {
+		int group;
+		int bit;
+	};
+
+	/// Chemin du périphérique de la puce
+	string chipPath;
+	/// Descripteur de la puce, -1 tant qu'elle n'est pas ouverte
+	int chipFd;
+	/// Groupes de lignes réservés
+	vector<LineGroup> groups;
+	/// Position de chaque ligne réservée, indexée par numéro de ligne (group = -1 si non réservée)
+	vector<LineRef> lines;
+
+	bool openChip();
+	bool requestGroup(const int* nums, size_t count, bool output, uint64_t highMask);
+	bool applyConfig(LineGroup& g);
+	const LineRef* find(int num) const;
+};
+
+#endif
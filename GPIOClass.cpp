@@ -3,30 +3,42 @@
 
 \brief Implémentation de la classe CGPIO pour piloter les Entrées/Sorties Tout Ou Rien (E/S TOR)
 */
-#include <fstream>
 #include <string>
 #include <iostream>
 
 #include "GPIOClass.h"
+#include "GPIOSysfsBackend.h"
+#include "Instrumentation.h"
+#include "EnregistreurBroches.h"
 
 using namespace std;
 
-CGPIO::CGPIO(int gNum, CGPIODirection dir, CGPIOValue val)
+CGPIO::CGPIO(int gNum, CGPIODirection dir, CGPIOValue val, CGPIOBackend* backend)
 {
 	this->gpioNum = gNum;
 	this->direction = dir;
 	this->value = val;
-	this->dirPath = "/sys/class/gpio/gpio" + to_string(this->gpioNum) + "/direction";
-	this->valPath = "/sys/class/gpio/gpio" + to_string(this->gpioNum) + "/value";
+	this->backend = (backend != nullptr) ? backend : getDefaultBackend();
 }
 
 bool CGPIO::init()
 {
         if (this->gpioNum < 0) {
                 error = "OPERATION FAILED: A GPIO cant have a negative value";
+                Instrumentation::countError(Instrumentation::Erreur::GPIO);
                 return false;
         }
     
+	// Une sortie est réservée directement avec son niveau initial : avec les
+	// méthodes d'accés qui le permettent (CGPIOCdevBackend), elle ne passe
+	// pas par l'état bas avant fixValue()
+	if (this->direction == CGPIODirection::OUT &&
+	    !backend->requestPins(&this->gpioNum, 1, true, this->value == CGPIOValue::HIGH ? 0x1 : 0x0)) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
+		return false;
+	}
+
 	if (!exportGPIO())
 		return false;
 
@@ -35,11 +47,16 @@ bool CGPIO::init()
 		return false;
 	}
 
-	readWriteValue.open(valPath.c_str()); 
-	if (!readWriteValue.is_open()){
+	bool ouvert;
+	{
+		Instrumentation::Chrono chrono(Instrumentation::Latence::OuvertureValeur);
+		Instrumentation::countOperation(Instrumentation::Operation::OuvertureValeur);
+		ouvert = backend->openValue(this->gpioNum);
+	}
+	if (!ouvert) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
 		unexportGPIO();
-		error = "OPERATION FAILED: Unable to set the value of GPIO " + to_string(this->gpioNum) +
-			    "\nMaybe you need to be root !\n";
 		return false;
 	}
 
@@ -50,15 +67,14 @@ bool CGPIO::init()
 
 bool CGPIO::close()
 {
-        // Fermeture du fichier 'value' de la broche
-	if (readWriteValue.is_open())
-		readWriteValue.close();// close value file
+        // Fermeture de l'accés au niveau logique de la broche
+	backend->closeValue(this->gpioNum);
 
         // Remise en entréee de la broche concernée (config d'origine)
         if (!fixDirection(CGPIODirection::IN))
             return false;
         
-        // Suppression de la broche au niveau du sysfs
+        // Suppression de la broche au niveau de la méthode d'accés
 	if (!unexportGPIO())
 		return false;
 	return true;
@@ -66,25 +82,19 @@ bool CGPIO::close()
 
 bool CGPIO::fixDirection(CGPIODirection dir)
 {
-	ofstream setdirgpio(dirPath.c_str()); // open direction file for gpio
-	if (!setdirgpio.is_open()){
-		error =  "OPERATION FAILED: Unable to set direction of GPIO " + to_string(this->gpioNum) +
-			     "\nMaybe you need to be root !\n";
-		return false;
-	}
-
-	if (dir == CGPIODirection::IN)
+	bool fait;
 	{
-		setdirgpio << "in";
-		this->direction = CGPIODirection::IN;
+		Instrumentation::Chrono chrono(Instrumentation::Latence::Direction);
+		Instrumentation::countOperation(Instrumentation::Operation::Direction);
+		fait = backend->setDirection(this->gpioNum, dir == CGPIODirection::OUT);
 	}
-	else
-	{
-		setdirgpio << "out";
-		this->direction = CGPIODirection::OUT;
+	if (!fait) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
+		return false;
 	}
-	
-	setdirgpio.close(); // close direction file
+
+	this->direction = dir;
 	return true;
 }
 
@@ -93,47 +103,71 @@ bool CGPIO::fixValue(CGPIOValue val)
 {
 	if (this->direction == CGPIODirection::IN) {
 		error = "OPERATION FAILED: Unable to write on input GPIO " + to_string(this->gpioNum);
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
 		return false;
 	}
-	else
-		(val == CGPIOValue::LOW) ? readWriteValue << "0" : readWriteValue << "1"; //write value to value file
+	else {
+		Instrumentation::countWrite(this->gpioNum);
+		backend->writeValue(this->gpioNum, val == CGPIOValue::HIGH);
+		EnregistreurBroches::recordWrite(this->gpioNum, val == CGPIOValue::HIGH);
+	}
 	
-	readWriteValue.flush();
 	return true;
 }
 
 void CGPIO::fixHigh()
 {
-	readWriteValue << "1";
-	readWriteValue.flush();
+	Instrumentation::countWrite(this->gpioNum);
+	backend->writeValue(this->gpioNum, true);
+	EnregistreurBroches::recordWrite(this->gpioNum, true);
 }
 
 void CGPIO::fixLow()
 {
-	readWriteValue << "0";
-	readWriteValue.flush();
+	Instrumentation::countWrite(this->gpioNum);
+	backend->writeValue(this->gpioNum, false);
+	EnregistreurBroches::recordWrite(this->gpioNum, false);
 }
 
 bool CGPIO::readValue(CGPIOValue& val)
 {
-	string temp;
+	bool high;
 
 	if (this->direction == CGPIODirection::OUT) {
 		error = "OPERATION FAILED: Unable to read on output GPIO " + to_string(this->gpioNum);
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
 		return false;
 	}
 	else
 	{
-		readWriteValue >> temp;  //read gpio value
-		if (temp == "0")
-			val = CGPIOValue::LOW;
-		else
-			val = CGPIOValue::HIGH;
+		Instrumentation::countOperation(Instrumentation::Operation::Lecture);
+		if (!backend->readValue(this->gpioNum, high)) {
+			error = backend->getLastError();
+			Instrumentation::countError(Instrumentation::Erreur::GPIO);
+			return false;
+		}
+		val = high ? CGPIOValue::HIGH : CGPIOValue::LOW;
 		return true;
 	}
 }
 
 
+bool CGPIO::fixEdge(CGPIOEdge edge)
+{
+	if (this->direction == CGPIODirection::OUT) {
+		error = "OPERATION FAILED: Unable to detect edges on output GPIO " + to_string(this->gpioNum);
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
+		return false;
+	}
+	if (!backend->setEdge(this->gpioNum, edge)) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
+		return false;
+	}
+	return true;
+}
+
+
 int CGPIO::getNum() const {
 
 	return this->gpioNum;
@@ -147,33 +181,40 @@ string CGPIO::getLastError()
 	return temp;
 }
 
-bool CGPIO::exportGPIO()
+CGPIOBackend* CGPIO::getBackend() const
 {
-	string exportPath = "/sys/class/gpio/export";
-	ofstream exportgpio(exportPath.c_str()); // Open "export" file. Convert C++ string to C string. Required for all Linux pathnames
+	return this->backend;
+}
 
-	if (!exportgpio.is_open()){
-		error = "OPERATION FAILED: Unable to export GPIO " + to_string(this->gpioNum) +
-			"\nMaybe you need to be root !\n";
+CGPIOBackend* CGPIO::getDefaultBackend()
+{
+	static CGPIOSysfsBackend sysfs;
+	return &sysfs;
+}
+
+bool CGPIO::exportGPIO()
+{
+	bool exporte;
+	{
+		Instrumentation::Chrono chrono(Instrumentation::Latence::Export);
+		Instrumentation::countOperation(Instrumentation::Operation::Export);
+		exporte = backend->exportPin(this->gpioNum);
+	}
+	if (!exporte) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
 		return false;
 	}
-
-	exportgpio << to_string(this->gpioNum); //write GPIO number to export
-	exportgpio.close(); //close export file
 	return true;
 }
 
 bool CGPIO::unexportGPIO()
 {
-	string unexportPath = "/sys/class/gpio/unexport";
-	ofstream unexportgpio(unexportPath.c_str()); //Open unexport file
-	if (!unexportgpio.is_open()){
-		error = "OPERATION FAILED: Unable to unexport GPIO " + to_string(this->gpioNum) +
-			"\nMaybe you need to be root !\n";
+	Instrumentation::countOperation(Instrumentation::Operation::Unexport);
+	if (!backend->unexportPin(this->gpioNum)) {
+		error = backend->getLastError();
+		Instrumentation::countError(Instrumentation::Erreur::GPIO);
 		return false;
 	}
-
-	unexportgpio << to_string(this->gpioNum); //write GPIO number to unexport
-	unexportgpio.close(); //close unexport file
 	return true;
-}
\ No newline at end of file
+}
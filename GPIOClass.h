@@ -24,6 +24,11 @@ indique si l'action demandée a réussi ou échoué. Il est donc de la responsab
 l'utilisateur de cette classe de tester le booléen de retour.
 Pour obtenir une description de l'erreur, il faut faire appel à la méthode getLastError().
 
+L'accés matériel proprement dit est délégué à un objet CGPIOBackend passé au constructeur :
+par défaut l'interface sysfs (CGPIOSysfsBackend) est utilisée, ce qui correspond au comportement
+historique de la classe. Pour obtenir des changements d'état beaucoup plus rapides sur une
+RaspberryPi, il suffit de fournir un objet CGPIOMmapBackend partagé par toutes les broches.
+
 */
 
 #ifndef GPIO_CLASS_H
@@ -31,7 +36,7 @@ Pour obtenir une description de l'erreur, il faut faire appel à la méthode get
 
 #include <cstdint>
 #include <string>
-#include <fstream>
+#include "GPIOBackend.h"
 
 using namespace std;
 
@@ -62,8 +67,11 @@ public:
 	* \param[in] gNum Numéro de la broche E/S concernée, le numéro est géré par le noyau et dépend de la carte concernée.
 	* \param[in] dir Direction de la broche E/S (soit entrée, soit sortie) de type CGPIODirection. Par défaut, la direction est en entrée.
 	* \param[in] val Valeur logique pour la broche concernée mise en sortie. Par défaut, la sortie est mise à l'état bas.
+	* \param[in] backend Méthode d'accés matériel à utiliser. Par défaut (nullptr), l'interface sysfs est utilisée.
+	* L'objet pointé n'appartient pas à la classe et doit exister tant que la broche est utilisée.
 	*/
-	CGPIO(int gNum, CGPIODirection dir = CGPIODirection::IN, CGPIOValue val = CGPIOValue::LOW);
+	CGPIO(int gNum, CGPIODirection dir = CGPIODirection::IN, CGPIOValue val = CGPIOValue::LOW,
+	      CGPIOBackend* backend = nullptr);
 
 	/**
 	* \brief Méthode init
@@ -139,6 +147,17 @@ public:
 	*/
     bool readValue(CGPIOValue& val);
     
+	/**
+	* \brief Méthode fixEdge
+	*
+	* Cette méthode permet de choisir les fronts signalés par une broche configurée en entrée. Les fronts
+	* sont ensuite attendus sans scrutation par un objet CGPIOEventLoop.
+	*
+	* \param[in] edge Fronts à signaler de type CGPIOEdge (CGPIOEdge::NONE pour ne plus rien signaler).
+	* \return booléen qui indique si la méthode fixEdge() a échoué (false) ou réussi (true)
+	*/
+	bool fixEdge(CGPIOEdge edge);
+
 	/**
 	* \brief Méthode getNum
 	*
@@ -159,13 +178,30 @@ public:
 	*/
 	string getLastError();
 
+	/**
+	* \brief getBackend
+	*
+	* Cette méthode renvoie la méthode d'accés matériel utilisée par la broche.
+	*
+	* \return un pointeur vers l'objet CGPIOBackend utilisé
+	*/
+	CGPIOBackend* getBackend() const;
+
+	/**
+	* \brief getDefaultBackend
+	*
+	* Cette méthode renvoie l'objet CGPIOSysfsBackend partagé, utilisé lorsqu'aucune méthode d'accés
+	* n'est fournie au constructeur.
+	*
+	* \return un pointeur vers l'objet CGPIOBackend par défaut
+	*/
+	static CGPIOBackend* getDefaultBackend();
+
 private:
 	/// Entier qui représente la broche concernée
 	int gpioNum;  
-	/// Chaine qui contient le chemin pour fixer le sens (la direction) de la broche concernée (généralement /sys/class/gpio/gpioX/direction)
-	string dirPath;
-	/// Chaine qui contient le chemin pour fixer la valeur (le niveau logique) de la broche concernée (généralement /sys/class/gpio/gpioX/value)
-	string valPath;
+	/// Méthode d'accés matériel utilisée pour piloter la broche (sysfs, registres...)
+	CGPIOBackend* backend;
 	/// la direction (le sens) de la broche concernée, donc soit entrée, soit sortie. Attention cette variable est du
 	/// type CGPIODirection
 	CGPIODirection direction;
@@ -174,14 +210,11 @@ private:
 	CGPIOValue value;
 	/// cette chaine contient le dernier message d'erreur
 	string error;
-	/// La variable qui contient l'identifiant du pseudo fichier qui permet de piloter la broche. Comme une broche
-	/// peut être en entrée ou en sortie, cette variable est du type fstream (permet de lire ou d'écrire dans ce fichier)
-	fstream readWriteValue;
 	
 	/**
 	* \brief exportGPIO
 	*
-	* Cette méthode permet d'exporter la broche concernée au niveau du pseudo système de fichiers sysfs.
+	* Cette méthode permet d'exporter la broche concernée auprés de la méthode d'accés matériel (sysfs...).
 	*
 	* \return un booléen qui indique si l'exportation a fonctionné (true) ou non (false)
 	*/
@@ -190,7 +223,7 @@ private:
 	/**
 	* \brief unexportGPIO
 	*
-	* Cette méthode permet d'enlever la broche concernée au niveau du pseudo système de fichiers sysfs.
+	* Cette méthode permet d'enlever la broche concernée auprés de la méthode d'accés matériel (sysfs...).
 	*
 	* \return un booléen qui indique si le retrait de la broche a fonctionné (true) ou non (false)
 	*/
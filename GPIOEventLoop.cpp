@@ -0,0 +1,280 @@
+/**
+\file GPIOEventLoop.cpp
+
+\brief Implémentation de la classe CGPIOEventLoop (attente des fronts des broches en entrée)
+*/
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "GPIOEventLoop.h"
+
+using namespace std;
+
+static uint64_t monotonic()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+CGPIOEventLoop::CGPIOEventLoop()
+{
+	this->epollFd = -1;
+	this->stopFd = -1;
+	this->running = false;
+}
+
+CGPIOEventLoop::~CGPIOEventLoop()
+{
+	if (epollFd >= 0)
+		::close(epollFd);
+	if (stopFd >= 0)
+		::close(stopFd);
+}
+
+bool CGPIOEventLoop::init()
+{
+	if (epollFd >= 0)
+		return true;
+
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (epollFd < 0 || stopFd < 0) {
+		error = string("OPERATION FAILED: Unable to create the event loop : ") + strerror(errno) + "\n";
+		return false;
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = stopFd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev) < 0) {
+		error = string("OPERATION FAILED: Unable to create the event loop : ") + strerror(errno) + "\n";
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOEventLoop::add(CGPIO& pin, CGPIOEdge edge, Callback callback, std::chrono::microseconds debounce)
+{
+	int num = pin.getNum();
+	if (epollFd < 0) {
+		error = "OPERATION FAILED: The event loop is not initialized";
+		return false;
+	}
+	if (watches.count(num) != 0) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " is already watched";
+		return false;
+	}
+
+	// L'anti-rebond a besoin de tous les fronts pour savoir quand la broche est stable
+	bool filter = debounce.count() > 0;
+	if (!pin.fixEdge(filter ? CGPIOEdge::BOTH : edge)) {
+		error = pin.getLastError();
+		return false;
+	}
+
+	uint32_t events;
+	int fd = pin.getBackend()->getEdgeFd(num, events);
+	CGPIO::CGPIOValue value;
+	if (fd < 0 || !pin.readValue(value)) {
+		error = (fd < 0) ? "OPERATION FAILED: GPIO " + to_string(num) + " cant signal its edges" : pin.getLastError();
+		pin.fixEdge(CGPIOEdge::NONE);
+		return false;
+	}
+
+	Source& source = fds[fd];
+	source.backend = pin.getBackend();
+	if (source.count++ == 0) {
+		struct epoll_event ev;
+		ev.events = events;
+		ev.data.fd = fd;
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			error = "OPERATION FAILED: Unable to watch GPIO " + to_string(num) + " : " + strerror(errno) + "\n";
+			fds.erase(fd);
+			pin.fixEdge(CGPIOEdge::NONE);
+			return false;
+		}
+	}
+
+	Watch& w = watches[num];
+	w.pin = &pin;
+	w.edge = edge;
+	w.callback = callback;
+	w.debounce = std::chrono::duration_cast<std::chrono::nanoseconds>(debounce).count();
+	w.fd = fd;
+	w.stable = (value == CGPIO::CGPIOValue::HIGH);
+	w.pending = false;
+	w.deadline = 0;
+	return true;
+}
+
+bool CGPIOEventLoop::remove(CGPIO& pin)
+{
+	auto it = watches.find(pin.getNum());
+	if (it == watches.end()) {
+		error = "OPERATION FAILED: GPIO " + to_string(pin.getNum()) + " is not watched";
+		return false;
+	}
+
+	int fd = it->second.fd;
+	watches.erase(it);
+	if (--fds[fd].count == 0) {
+		fds.erase(fd);
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	}
+
+	if (!pin.fixEdge(CGPIOEdge::NONE)) {
+		error = pin.getLastError();
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOEventLoop::signal(Watch& w, const CGPIOEvent& e)
+{
+	if ((w.edge == CGPIOEdge::RISING && !e.high) || (w.edge == CGPIOEdge::FALLING && e.high) ||
+	    w.edge == CGPIOEdge::NONE)
+		return false;
+
+	// Copie : la fonction de rappel peut retirer la broche de la boucle
+	Callback callback = w.callback;
+	callback(e);
+	return true;
+}
+
+int CGPIOEventLoop::dispatch(int fd)
+{
+	auto source = fds.find(fd);
+	if (source == fds.end())
+		return 0;
+	CGPIOBackend* backend = source->second.backend;
+
+	CGPIOEvent events[16];
+	int n = backend->readEdges(fd, events, 16);
+	if (n < 0) {
+		error = backend->getLastError();
+		return -1;
+	}
+
+	int count = 0;
+	for (int i = 0; i < n; i++) {
+		auto it = watches.find(events[i].num);
+		if (it == watches.end() || it->second.fd != fd)
+			continue;
+		Watch& w = it->second;
+
+		if (w.debounce == 0) {
+			// Sans anti-rebond, chaque changement de niveau est signalé
+			if (events[i].high != w.stable) {
+				w.stable = events[i].high;
+				if (signal(w, events[i]))
+					count++;
+			}
+			continue;
+		}
+
+		// Un nouveau front repousse la fin de l'anti-rebond ; un retour au
+		// niveau validé annule le changement (rebond)
+		w.last = events[i];
+		w.deadline = events[i].timestamp + w.debounce;
+		w.pending = (events[i].high != w.stable);
+	}
+	return count;
+}
+
+int CGPIOEventLoop::expire(uint64_t now)
+{
+	vector<int> ready;
+	for (auto& entry : watches)
+		if (entry.second.pending && entry.second.deadline <= now)
+			ready.push_back(entry.first);
+
+	int count = 0;
+	for (int num : ready) {
+		auto it = watches.find(num);
+		if (it == watches.end() || !it->second.pending)
+			continue;
+		Watch& w = it->second;
+		w.pending = false;
+		w.stable = w.last.high;
+		if (signal(w, w.last))
+			count++;
+	}
+	return count;
+}
+
+int CGPIOEventLoop::nextTimeout(uint64_t now, int timeout) const
+{
+	for (auto& entry : watches) {
+		if (!entry.second.pending)
+			continue;
+		// Arrondi à la milliseconde supérieure pour ne pas se réveiller trop tôt
+		uint64_t remaining = (entry.second.deadline > now) ? entry.second.deadline - now : 0;
+		int ms = (int)((remaining + 999999) / 1000000);
+		if (timeout < 0 || ms < timeout)
+			timeout = ms;
+	}
+	return timeout;
+}
+
+int CGPIOEventLoop::poll(int timeout)
+{
+	if (epollFd < 0) {
+		error = "OPERATION FAILED: The event loop is not initialized";
+		return -1;
+	}
+
+	int count = expire(monotonic());
+	struct epoll_event events[64];
+	int n = epoll_wait(epollFd, events, 64, nextTimeout(monotonic(), count > 0 ? 0 : timeout));
+	if (n < 0) {
+		if (errno == EINTR)
+			return count;
+		error = string("OPERATION FAILED: Unable to wait for GPIO events : ") + strerror(errno) + "\n";
+		return -1;
+	}
+
+	for (int i = 0; i < n; i++) {
+		int fd = events[i].data.fd;
+		if (fd == stopFd) {
+			uint64_t value;
+			::read(stopFd, &value, sizeof(value));
+			running = false;
+			continue;
+		}
+		int k = dispatch(fd);
+		if (k < 0)
+			return -1;
+		count += k;
+	}
+	return count + expire(monotonic());
+}
+
+bool CGPIOEventLoop::run()
+{
+	running = true;
+	while (running) {
+		if (poll(-1) < 0)
+			return false;
+	}
+	return true;
+}
+
+void CGPIOEventLoop::stop()
+{
+	uint64_t one = 1;
+	::write(stopFd, &one, sizeof(one));
+}
+
+string CGPIOEventLoop::getLastError()
+{
+	string temp = this->error;
+	this->error = "No error \n";
+	return temp;
+}
@@ -0,0 +1,120 @@
+/**
+\file GPIOEventLoop.h
+Déclaration de la classe CGPIOEventLoop
+\class CGPIOEventLoop
+\brief Attente des fronts de broches en entrée (boutons, capteurs) sans scrutation
+
+La méthode readValue() de la classe CGPIO ne permet que de scruter une entrée : pour ne pas manquer
+un appui, il faut une boucle qui occupe le processeur à 100 %. Cette classe attend au contraire les
+fronts signalés par le noyau (attribut 'edge' en sysfs, événements de ligne en cdev) avec un seul
+descripteur epoll, qui peut surveiller des centaines de broches à la fois.
+
+Chaque front est daté (par le noyau en cdev, à la lecture en sysfs) puis filtré par un anti-rebond
+logiciel : le changement d'état n'est signalé que lorsque la broche est restée stable pendant la
+durée choisie. La fonction de rappel est appelée depuis le thread qui exécute run() ou poll().
+
+Comme les autres classes E/S, les méthodes renvoient un booléen qui indique si l'action demandée a
+réussi ou échoué, la description de l'erreur étant obtenue par getLastError().
+*/
+
+#ifndef GPIO_EVENT_LOOP_H
+#define GPIO_EVENT_LOOP_H
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include "GPIOClass.h"
+
+class CGPIOEventLoop
+{
+public:
+	/// Fonction appelée pour chaque changement d'état validé par l'anti-rebond
+	typedef std::function<void(const CGPIOEvent&)> Callback;
+
+	CGPIOEventLoop();
+	virtual ~CGPIOEventLoop();
+
+	/**
+	* \brief Crée le descripteur epoll et celui qui permet d'interrompre run()
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool init();
+
+	/**
+	* \brief Surveille une broche en entrée déjà initialisée
+	*
+	* Avec un anti-rebond, la broche signale tous ses fronts et ceux qui ne correspondent pas à 'edge'
+	* sont écartés aprés validation.
+	* \param[in] pin Broche en entrée, qui doit exister tant qu'elle est surveillée
+	* \param[in] edge Fronts à signaler (RISING, FALLING ou BOTH)
+	* \param[in] callback Fonction appelée pour chaque front validé
+	* \param[in] debounce Durée pendant laquelle la broche doit rester stable (0 : pas d'anti-rebond)
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool add(CGPIO& pin, CGPIOEdge edge, Callback callback,
+	         std::chrono::microseconds debounce = std::chrono::microseconds(0));
+
+	/**
+	* \brief Arrête la surveillance d'une broche (ses fronts ne sont plus signalés)
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool remove(CGPIO& pin);
+
+	/**
+	* \brief Attend et traite les fronts pendant au plus 'timeout' millisecondes (-1 : sans limite)
+	* \return le nombre de fonctions de rappel appelées, -1 en cas d'erreur
+	*/
+	int poll(int timeout);
+
+	/**
+	* \brief Traite les fronts jusqu'à l'appel de stop()
+	* \return booléen qui indique si la boucle s'est arrêtée sur une erreur (false) ou par stop() (true)
+	*/
+	bool run();
+
+	/**
+	* \brief Interrompt run(), peut être appelée depuis n'importe quel thread
+	*/
+	void stop();
+
+	/**
+	* \brief Renvoie le dernier message d'erreur puis le réinitialise
+	*/
+	string getLastError();
+
+private:
+	struct Watch {
+		CGPIO* pin;
+		CGPIOEdge edge;
+		Callback callback;
+		uint64_t debounce;	///< en nanosecondes
+		int fd;
+		bool stable;		///< dernier niveau validé
+		bool pending;		///< un changement attend la fin de l'anti-rebond
+		CGPIOEvent last;	///< dernier front lu
+		uint64_t deadline;	///< fin de l'anti-rebond du dernier front
+	};
+
+	int epollFd;
+	int stopFd;
+	bool running;
+	/// Broches surveillées, indexées par numéro
+	std::map<int, Watch> watches;
+	/// Descripteur surveillé : nombre de broches qui le partagent (lignes d'une requête cdev)
+	/// et méthode d'accés qui sait le lire
+	struct Source {
+		int count;
+		CGPIOBackend* backend;
+	};
+	std::map<int, Source> fds;
+	string error;
+
+	int dispatch(int fd);
+	int expire(uint64_t now);
+	bool signal(Watch& w, const CGPIOEvent& e);
+	int nextTimeout(uint64_t now, int timeout) const;
+};
+
+#endif
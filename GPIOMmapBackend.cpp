@@ -0,0 +1,178 @@
+/**
+\file GPIOMmapBackend.cpp
+
+\brief Implémentation de la classe CGPIOMmapBackend (accés aux broches par registres projetés)
+*/
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "GPIOMmapBackend.h"
+
+using namespace std;
+
+CGPIOMmapBackend::CGPIOMmapBackend(const string& path)
+{
+	this->path = path;
+	this->fd = -1;
+	this->regs = nullptr;
+	this->mapSize = 0;
+}
+
+CGPIOMmapBackend::CGPIOMmapBackend(int fd)
+{
+	this->fd = ::dup(fd);
+	this->regs = nullptr;
+	this->mapSize = 0;
+}
+
+CGPIOMmapBackend::~CGPIOMmapBackend()
+{
+	if (regs != nullptr)
+		munmap((void*)regs, mapSize);
+	if (fd >= 0)
+		::close(fd);
+}
+
+bool CGPIOMmapBackend::mapRegisters()
+{
+	if (regs != nullptr)
+		return true;
+
+	if (fd < 0) {
+		fd = ::open(path.c_str(), O_RDWR | O_SYNC | O_CLOEXEC);
+		if (fd < 0) {
+			error = "OPERATION FAILED: Unable to open " + path + " : " + strerror(errno) + "\n";
+			return false;
+		}
+	}
+
+	// Un fichier ordinaire (ou un memfd) doit être assez grand pour contenir les registres,
+	// /dev/gpiomem est un fichier spécial dont la taille n'est pas significative
+	struct stat st;
+	bool regular = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+	if (regular && (size_t)st.st_size < registersSize) {
+		error = "OPERATION FAILED: GPIO register file is too small\n";
+		return false;
+	}
+
+	mapSize = regular ? registersSize : (size_t)sysconf(_SC_PAGESIZE);
+	void* addr = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		error = string("OPERATION FAILED: Unable to map GPIO registers : ") + strerror(errno) + "\n";
+		return false;
+	}
+	regs = (volatile uint32_t*)addr;
+	return true;
+}
+
+bool CGPIOMmapBackend::exportPin(int num)
+{
+	if (num < 0 || num >= nbPins) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " does not exist on this chip";
+		return false;
+	}
+	return mapRegisters();
+}
+
+bool CGPIOMmapBackend::unexportPin(int num)
+{
+	// Il n'y a rien à libérer : la broche reste dans l'état laissé par setDirection()
+	return true;
+}
+
+bool CGPIOMmapBackend::setDirection(int num, bool output)
+{
+	// Une broche hors du bloc ferait écrire au-delà des registres GPFSEL
+	if (num < 0 || num >= nbPins) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " does not exist on this chip";
+		return false;
+	}
+	if (regs == nullptr && !mapRegisters())
+		return false;
+
+	// 3 bits de fonction par broche, 10 broches par registre GPFSEL (000 : entrée, 001 : sortie)
+	size_t reg = GPFSEL0 + num / 10;
+	unsigned shift = (num % 10) * 3;
+	uint32_t fsel = regs[reg] & ~(7u << shift);
+	if (output)
+		fsel |= 1u << shift;
+	regs[reg] = fsel;
+	return true;
+}
+
+bool CGPIOMmapBackend::openValue(int num)
+{
+	return regs != nullptr || mapRegisters();
+}
+
+void CGPIOMmapBackend::closeValue(int num)
+{
+}
+
+void CGPIOMmapBackend::writeValue(int num, bool high)
+{
+	regs[(high ? GPSET0 : GPCLR0) + num / 32] = 1u << (num % 32);
+}
+
+void CGPIOMmapBackend::writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask)
+{
+	// Regroupement des broches par banque de 32 : une écriture GPSET et une écriture GPCLR par banque
+	uint32_t set[2] = {0, 0};
+	uint32_t clr[2] = {0, 0};
+	for (size_t i = 0; i < count; i++) {
+		uint32_t bit = 1u << (nums[i] % 32);
+		if (setMask & (1u << i))
+			set[nums[i] / 32] |= bit;
+		else if (clearMask & (1u << i))
+			clr[nums[i] / 32] |= bit;
+	}
+
+	for (int bank = 0; bank < 2; bank++) {
+		if (set[bank])
+			regs[GPSET0 + bank] = set[bank];
+		if (clr[bank])
+			regs[GPCLR0 + bank] = clr[bank];
+	}
+}
+
+void CGPIOMmapBackend::writeSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n)
+{
+	// Conversion préalable de chaque broche en (banque, bit) : la boucle de la séquence
+	// ne fait plus que des OU logiques et des écritures dans les registres
+	uint32_t bits[32];
+	uint8_t banks[32];
+	for (size_t i = 0; i < count; i++) {
+		bits[i] = 1u << (nums[i] % 32);
+		banks[i] = nums[i] / 32;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t set[2] = {0, 0};
+		uint32_t clr[2] = {0, 0};
+		for (uint32_t m = steps[i].setMask; m != 0; m &= m - 1) {
+			int b = __builtin_ctz(m);
+			set[banks[b]] |= bits[b];
+		}
+		for (uint32_t m = steps[i].clearMask & ~steps[i].setMask; m != 0; m &= m - 1) {
+			int b = __builtin_ctz(m);
+			clr[banks[b]] |= bits[b];
+		}
+		for (int bank = 0; bank < 2; bank++) {
+			if (set[bank])
+				regs[GPSET0 + bank] = set[bank];
+			if (clr[bank])
+				regs[GPCLR0 + bank] = clr[bank];
+		}
+	}
+}
+
+bool CGPIOMmapBackend::readValue(int num, bool& high)
+{
+	high = (regs[GPLEV0 + num / 32] >> (num % 32)) & 1u;
+	return true;
+}
@@ -0,0 +1,98 @@
+/**
+\file GPIOMmapBackend.h
+Déclaration de la classe CGPIOMmapBackend
+\class CGPIOMmapBackend
+\brief Accés aux broches E/S TOR par les registres GPIO projetés en mémoire (type BCM283x)
+
+Le bloc de registres GPIO des processeurs BCM2835/2836/2837 (RaspberryPi) est projeté en mémoire
+par mmap() à partir du fichier /dev/gpiomem, qui ne nécessite pas les droits root. Un changement
+d'état d'une broche se résume alors à une écriture dans le registre GPSET ou GPCLR, sans aucun
+appel système : c'est plusieurs centaines de fois plus rapide que l'interface sysfs.
+
+Le fichier des registres peut être remplacé par n'importe quel fichier (fichier ordinaire, memfd...)
+d'au moins registersSize octets : la classe peut ainsi être utilisée sur un PC Linux classique, sans
+carte. Dans ce cas les registres GPLEV ne sont évidemment pas mis à jour par le matériel.
+*/
+
+#ifndef GPIO_MMAP_BACKEND_H
+#define GPIO_MMAP_BACKEND_H
+
+#include <cstdint>
+#include <cstddef>
+#include "GPIOBackend.h"
+
+class CGPIOMmapBackend : public CGPIOBackend
+{
+public:
+	/// Nombre de broches gérées par le bloc GPIO (BCM283x)
+	static const int nbPins = 54;
+	/// Taille minimale du bloc de registres en octets (de GPFSEL0 à GPPUDCLK1)
+	static const size_t registersSize = 0xB4;
+
+	/**
+	* \brief Constructeur à partir du chemin du fichier des registres
+	* \param[in] path Chemin du fichier à projeter en mémoire (par défaut /dev/gpiomem)
+	*/
+	CGPIOMmapBackend(const string& path = "/dev/gpiomem");
+
+	/**
+	* \brief Constructeur à partir d'un descripteur déjà ouvert (memfd, fichier ordinaire...)
+	*
+	* Le descripteur est dupliqué, l'appelant reste donc responsable de la fermeture du sien.
+	* \param[in] fd Descripteur du fichier des registres
+	*/
+	CGPIOMmapBackend(int fd);
+	virtual ~CGPIOMmapBackend();
+
+	virtual bool exportPin(int num);
+	virtual bool unexportPin(int num);
+	virtual bool setDirection(int num, bool output);
+	virtual bool openValue(int num);
+	virtual void closeValue(int num);
+	virtual void writeValue(int num, bool high);
+	virtual void writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask);
+	virtual void writeSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n);
+	virtual bool readValue(int num, bool& high);
+
+	/**
+	* \brief Ecriture directe du registre GPSET d'une banque de 32 broches (non virtuelle)
+	*
+	* Utilisée par PanneauStatique, dont les masques sont calculés à la compilation : l'appel
+	* se résume à une écriture en mémoire.
+	* \param[in] bank Banque (numéro de broche / 32)
+	* \param[in] mask Broches de la banque à mettre à l'état haut (bit numéro de broche % 32)
+	*/
+	void setBits(int bank, uint32_t mask) { regs[GPSET0 + bank] = mask; }
+	/**
+	* \brief Ecriture directe du registre GPCLR d'une banque de 32 broches (non virtuelle)
+	* \param[in] bank Banque (numéro de broche / 32)
+	* \param[in] mask Broches de la banque à mettre à l'état bas
+	*/
+	void clearBits(int bank, uint32_t mask) { regs[GPCLR0 + bank] = mask; }
+
+private:
+	/// Index (en mots de 32 bits) des registres utilisés
+	enum : size_t {
+		GPFSEL0 = 0x00 / 4,
+		GPSET0  = 0x1C / 4,
+		GPCLR0  = 0x28 / 4,
+		GPLEV0  = 0x34 / 4
+	};
+
+	/// Chemin du fichier des registres (vide si construit à partir d'un descripteur)
+	string path;
+	/// Descripteur du fichier des registres, -1 tant qu'il n'est pas ouvert
+	int fd;
+	/// Adresse des registres projetés, nullptr tant que la projection n'est pas faite
+	volatile uint32_t* regs;
+	/// Taille de la projection
+	size_t mapSize;
+
+	/**
+	* \brief Ouvre le fichier des registres et le projette en mémoire (une seule fois)
+	* \return booléen qui indique si la projection a échoué (false) ou réussi (true)
+	*/
+	bool mapRegisters();
+};
+
+#endif
@@ -0,0 +1,111 @@
+/**
+\file GPIOPort.cpp
+
+\brief Implémentation de la classe CGPIOPort (groupe de broches modifiées ensemble)
+*/
+#include <string>
+
+#include "GPIOPort.h"
+#include "Instrumentation.h"
+#include "EnregistreurBroches.h"
+
+using namespace std;
+
+const size_t CGPIOPort::maxPins;
+
+CGPIOPort::CGPIOPort(std::initializer_list<int> nums, CGPIOBackend* backend)
+	: CGPIOPort(nums.begin(), nums.size(), backend)
+{
+}
+
+CGPIOPort::CGPIOPort(const int* nums, size_t count, CGPIOBackend* backend)
+{
+	this->nums.assign(nums, nums + count);
+	this->backend = (backend != nullptr) ? backend : CGPIO::getDefaultBackend();
+}
+
+bool CGPIOPort::init(uint32_t highMask)
+{
+	if (nums.empty() || nums.size() > maxPins) {
+		error = "OPERATION FAILED: A GPIO port must have 1 to " + to_string(maxPins) + " GPIO";
+		return false;
+	}
+
+	// Réservation groupée (une seule requête avec le périphérique GPIO)
+	if (!backend->requestPins(nums.data(), nums.size(), true, highMask)) {
+		error = backend->getLastError();
+		return false;
+	}
+
+	pins.clear();
+	for (size_t i = 0; i < nums.size(); i++) {
+		CGPIO::CGPIOValue value = (highMask & (1u << i)) ? CGPIO::CGPIOValue::HIGH : CGPIO::CGPIOValue::LOW;
+		pins.emplace_back(nums[i], CGPIO::CGPIODirection::OUT, value, backend);
+		if (!pins.back().init()) {
+			error = pins.back().getLastError();
+			pins.pop_back();
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CGPIOPort::close()
+{
+	// Toutes les broches sont libérées, même si l'une d'elles échoue
+	bool ok = true;
+	for (CGPIO& pin : pins) {
+		if (!pin.close()) {
+			error = pin.getLastError();
+			ok = false;
+		}
+	}
+	pins.clear();
+	return ok;
+}
+
+void CGPIOPort::write(uint32_t setMask, uint32_t clearMask)
+{
+	backend->writeValues(nums.data(), nums.size(), setMask, clearMask);
+	if (Instrumentation::isEnabled()) {
+		CGPIOStep step = {setMask, clearMask};
+		Instrumentation::countSequence(nums.data(), nums.size(), &step, 1);
+	}
+	EnregistreurBroches::recordStep(nums.data(), nums.size(), setMask, clearMask);
+}
+
+void CGPIOPort::writeSequence(const CGPIOStep* steps, size_t n)
+{
+	// Les étapes sont datées entre le début et la fin de la séquence
+	if (EnregistreurBroches::isEnabled()) {
+		uint64_t debut = EnregistreurBroches::now();
+		backend->writeSequence(nums.data(), nums.size(), steps, n);
+		EnregistreurBroches::recordSequence(nums.data(), nums.size(), steps, n, debut, EnregistreurBroches::now());
+	}
+	else
+		backend->writeSequence(nums.data(), nums.size(), steps, n);
+	Instrumentation::countSequence(nums.data(), nums.size(), steps, n);
+}
+
+size_t CGPIOPort::size() const
+{
+	return nums.size();
+}
+
+int CGPIOPort::getNum(size_t i) const
+{
+	return nums[i];
+}
+
+CGPIOBackend* CGPIOPort::getBackend() const
+{
+	return backend;
+}
+
+string CGPIOPort::getLastError()
+{
+	string temp = this->error;
+	this->error = "No error \n";
+	return temp;
+}
@@ -0,0 +1,81 @@
+/**
+\file GPIOPort.h
+Déclaration de la classe CGPIOPort
+\class CGPIOPort
+\brief Groupe de broches en sortie modifiées ensemble par une seule opération
+
+Avec la classe CGPIO, chaque broche est modifiée séparément : positionner DATA puis produire un
+front sur CLK demande plusieurs appels, avec un décalage entre les broches. Un port regroupe
+jusqu'à 32 broches en sortie, désignées par leur rang dans le port (bit i des masques pour la
+i-ème broche), et les modifie par write(setMask, clearMask) :
+- registres projetés (CGPIOMmapBackend) : une écriture GPSET et une écriture GPCLR par banque ;
+- périphérique caractère (CGPIOCdevBackend) : les broches sont réservées par une seule requête
+  et modifiées par un seul ioctl GPIO_V2_LINE_SET_VALUES ;
+- sysfs (CGPIOSysfsBackend) : une écriture par broche modifiée, enchainées au plus vite.
+
+Comme pour la classe CGPIO, init() et close() renvoient un booléen qui indique si l'action
+demandée a réussi ou échoué, la description de l'erreur est obtenue par getLastError().
+write() et writeSequence() ne vérifient rien pour être le plus rapide possible.
+*/
+
+#ifndef GPIO_PORT_H
+#define GPIO_PORT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+#include "GPIOClass.h"
+
+class CGPIOPort
+{
+public:
+	/// Nombre maximal de broches d'un port (largeur des masques)
+	static const size_t maxPins = 32;
+
+	/**
+	* \brief Constructeur de la classe CGPIOPort
+	* \param[in] nums Numéros des broches, dans l'ordre des bits des masques
+	* \param[in] backend Méthode d'accés matériel à utiliser. Par défaut (nullptr), l'interface sysfs est utilisée.
+	*/
+	CGPIOPort(std::initializer_list<int> nums, CGPIOBackend* backend = nullptr);
+	CGPIOPort(const int* nums, size_t count, CGPIOBackend* backend = nullptr);
+
+	/**
+	* \brief Réserve les broches en une seule opération puis les initialise en sortie
+	* \param[in] highMask Broches à mettre à l'état haut au départ (les autres sont à l'état bas)
+	* \return booléen qui indique si la méthode init() a échoué (false) ou réussi (true)
+	*/
+	bool init(uint32_t highMask = 0);
+
+	/**
+	* \brief Libère toutes les broches du port
+	* \return booléen qui indique si la méthode close() a échoué (false) ou réussi (true)
+	*/
+	bool close();
+
+	/**
+	* \brief Met à l'état haut les broches de setMask et à l'état bas celles de clearMask, en une opération
+	*/
+	void write(uint32_t setMask, uint32_t clearMask);
+
+	/**
+	* \brief Rejoue une séquence d'écritures précalculée (voir CGPIOBackend::writeSequence())
+	*/
+	void writeSequence(const CGPIOStep* steps, size_t n);
+
+	/// Nombre de broches du port
+	size_t size() const;
+	/// Numéro de la i-ème broche du port
+	int getNum(size_t i) const;
+	CGPIOBackend* getBackend() const;
+	string getLastError();
+
+private:
+	vector<int> nums;
+	vector<CGPIO> pins;
+	CGPIOBackend* backend;
+	string error;
+};
+
+#endif
@@ -0,0 +1,258 @@
+/**
+\file GPIOSimBackend.cpp
+
+\brief Implémentation de la classe CGPIOSimBackend (simulation d'une chaine de registres à décalage)
+*/
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+#include "GPIOSimBackend.h"
+
+using namespace std;
+
+/// Date des événements qui n'ont pas encore eu lieu : aucune contrainte ne peut être violée
+static const int64_t never = INT64_MIN / 2;
+
+static CGPIOSimStats difference(const CGPIOSimStats& a, const CGPIOSimStats& b)
+{
+	CGPIOSimStats d;
+	d.operations = a.operations - b.operations;
+	d.transitions = a.transitions - b.transitions;
+	d.clocks = a.clocks - b.clocks;
+	d.latches = a.latches - b.latches;
+	d.setupViolations = a.setupViolations - b.setupViolations;
+	d.holdViolations = a.holdViolations - b.holdViolations;
+	d.clockViolations = a.clockViolations - b.clockViolations;
+	return d;
+}
+
+CGPIOSimBackend::CGPIOSimBackend(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk, const CGPIOSimTiming& timing)
+	: CGPIOSimBackend(nbAfficheurs, pinOE, pinLE, vector<int>{pinData}, pinClk, timing)
+{
+}
+
+CGPIOSimBackend::CGPIOSimBackend(int nbAfficheurs, int pinOE, int pinLE, const vector<int>& pinsData, int pinClk,
+                                 const CGPIOSimTiming& timing)
+{
+	this->nbAfficheurs = nbAfficheurs > 0 ? nbAfficheurs : 1;
+	int lignes = pinsData.empty() ? 1 : (int)pinsData.size();
+	this->longueur = (this->nbAfficheurs + lignes - 1) / lignes;
+	this->pins = {pinOE, pinLE, pinClk};
+	this->pins.insert(this->pins.end(), pinsData.begin(), pinsData.end());
+	if (pinsData.empty())
+		this->pins.push_back(-1);
+	this->timing = timing;
+
+	// OE est actif à l'état bas : les sorties sont éteintes jusqu'à la première écriture
+	this->levels.assign(this->pins.size(), 0);
+	this->levels[OE] = 1;
+	this->nextLevels = this->levels;
+
+	this->bits.assign(lignes, vector<uint8_t>(this->longueur * 8, 0));
+	this->head = 0;
+	this->outputs.assign(this->nbAfficheurs, 0);
+
+	this->now = 0;
+	this->dataChange = never;
+	this->clockRise = never;
+	this->clockChange = never;
+	resetStats();
+}
+
+int CGPIOSimBackend::role(int num) const
+{
+	for (size_t r = 0; r < pins.size(); r++)
+		if (pins[r] == num)
+			return (int)r;
+	return NONE;
+}
+
+bool CGPIOSimBackend::exportPin(int num)
+{
+	if (num < 0) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " does not exist";
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOSimBackend::unexportPin(int num)
+{
+	return true;
+}
+
+bool CGPIOSimBackend::setDirection(int num, bool output)
+{
+	return true;
+}
+
+bool CGPIOSimBackend::openValue(int num)
+{
+	return true;
+}
+
+void CGPIOSimBackend::closeValue(int num)
+{
+}
+
+void CGPIOSimBackend::writeValue(int num, bool high)
+{
+	lock_guard<std::mutex> lock(mutex);
+	nextLevels = levels;
+	int r = role(num);
+	if (r != NONE)
+		nextLevels[r] = high;
+	else {
+		if ((size_t)num >= others.size())
+			others.resize(num + 1, false);
+		others[num] = high;
+	}
+	step();
+}
+
+void CGPIOSimBackend::writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask)
+{
+	lock_guard<std::mutex> lock(mutex);
+	nextLevels = levels;
+	for (size_t i = 0; i < count; i++) {
+		bool high;
+		if (setMask & (1u << i))
+			high = true;
+		else if (clearMask & (1u << i))
+			high = false;
+		else
+			continue;
+
+		int r = role(nums[i]);
+		if (r != NONE)
+			nextLevels[r] = high;
+		else {
+			if ((size_t)nums[i] >= others.size())
+				others.resize(nums[i] + 1, false);
+			others[nums[i]] = high;
+		}
+	}
+	step();
+}
+
+bool CGPIOSimBackend::readValue(int num, bool& high)
+{
+	lock_guard<std::mutex> lock(mutex);
+	int r = role(num);
+	if (r != NONE)
+		high = levels[r];
+	else
+		high = (size_t)num < others.size() && others[num];
+	return true;
+}
+
+void CGPIOSimBackend::step()
+{
+	const vector<uint8_t>& next = nextLevels;
+	now += timing.writeNs;
+	stats.operations++;
+
+	bool dataChanged = false;
+	for (size_t r = DATA; r < levels.size(); r++)
+		dataChanged |= next[r] != levels[r];
+	bool clockChanged = next[CLK] != levels[CLK];
+	bool latchRising = next[LE] && !levels[LE];
+	for (size_t r = 0; r < levels.size(); r++)
+		if (next[r] != levels[r])
+			stats.transitions++;
+
+	if (dataChanged) {
+		if (timing.holdNs != 0 && now - clockRise < timing.holdNs)
+			stats.holdViolations++;
+		dataChange = now;
+	}
+
+	if (clockChanged) {
+		int64_t halfPeriod = timing.clockPeriodNs / 2;
+		bool violation = now - clockChange < halfPeriod;
+		if (next[CLK]) {
+			if (now - clockRise < timing.clockPeriodNs)
+				violation = true;
+			// Un changement de DATA simultané du front montant est toujours une violation
+			if (dataChange == now || now - dataChange < timing.setupNs)
+				stats.setupViolations++;
+
+			// Décalage de toutes les sous-chaines : chaque ligne DATA entre en position 0
+			head = (head == 0 ? bits[0].size() : head) - 1;
+			for (size_t l = 0; l < bits.size(); l++)
+				bits[l][head] = next[DATA + l];
+			clockRise = now;
+			stats.clocks++;
+		}
+		if (violation)
+			stats.clockViolations++;
+		clockChange = now;
+	}
+
+	levels = next;
+
+	if (latchRising) {
+		latch();
+		stats.latches++;
+		lastFrame = difference(stats, frameStart);
+		frameStart = stats;
+	}
+}
+
+void CGPIOSimBackend::latch()
+{
+	// Le premier bit envoyé (bit 0 de l'afficheur le plus à gauche) est au bout de chaque sous-chaine :
+	// dans une sous-chaine de 'taille' afficheurs, le bit j de son afficheur d est en position
+	// 8 * (taille - d) - 1 - j
+	size_t size = bits[0].size();
+	for (int k = 0; k < nbAfficheurs; k++) {
+		int ligne = k / longueur;
+		int taille = std::min(nbAfficheurs - ligne * longueur, longueur);
+		uint8_t value = 0;
+		size_t position = 8 * (taille - (k - ligne * longueur)) - 1;
+		for (int j = 0; j < 8; j++, position--)
+			value |= bits[ligne][(head + position) % size] << j;
+		outputs[k] = value;
+	}
+}
+
+uint8_t CGPIOSimBackend::getSegments(int afficheur) const
+{
+	lock_guard<std::mutex> lock(mutex);
+	if (afficheur < 0 || afficheur >= nbAfficheurs)
+		return 0;
+	return outputs[afficheur];
+}
+
+bool CGPIOSimBackend::isOutputEnabled() const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return !levels[OE];
+}
+
+uint64_t CGPIOSimBackend::getTime() const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return now;
+}
+
+CGPIOSimStats CGPIOSimBackend::getStats() const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+CGPIOSimStats CGPIOSimBackend::getLastFrameStats() const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return lastFrame;
+}
+
+void CGPIOSimBackend::resetStats()
+{
+	lock_guard<std::mutex> lock(mutex);
+	memset(&stats, 0, sizeof(stats));
+	memset(&frameStart, 0, sizeof(frameStart));
+	memset(&lastFrame, 0, sizeof(lastFrame));
+}
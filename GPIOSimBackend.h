@@ -0,0 +1,153 @@
+/**
+\file GPIOSimBackend.h
+Déclaration de la classe CGPIOSimBackend
+\class CGPIOSimBackend
+\brief Simulation, en mémoire, d'une chaine de registres à décalage (TPIC6B595, 74HC595) pilotée par OE, LE, DATA et CLK
+
+Cette méthode d'accés ne pilote aucun matériel : elle reproduit le comportement de la chaine de registres
+qui se trouve derrière un panneau, à partir des changements d'état des broches :
+- front montant de CLK : la chaine est décalée d'un bit et DATA entre dans le premier registre ;
+- front montant de LE : le contenu des registres est transféré sur les sorties ;
+- OE à l'état bas : les sorties sont actives.
+Les segments allumés sur chaque afficheur sont donc ceux que montrerait le panneau (getSegments()).
+Avec K lignes DATA, la chaine est partagée comme par PanneauAffichage en K sous-chaines de
+ceil(nbAfficheurs / K) afficheurs consécutifs (la dernière peut être plus courte), décalées par
+la même horloge CLK et verrouillées par le même front de LE.
+
+Le temps est simulé : chaque opération d'écriture (writeValue(), writeValues() ou étape d'une séquence)
+dure 'writeNs' nanosecondes, les broches modifiées par une même opération changent au même instant.
+La simulation relève alors les violations des contraintes de la chaine :
+- temps d'établissement (setup) : DATA doit être stable 'setupNs' avant le front montant de CLK, un
+  changement simultané est toujours une violation ;
+- temps de maintien (hold) : DATA doit rester stable 'holdNs' aprés le front montant de CLK ;
+- période d'horloge : deux fronts montants de CLK doivent être séparés d'au moins 'clockPeriodNs', et
+  CLK doit rester au moins une demi-période à chaque niveau.
+
+Les statistiques (opérations, changements d'état, violations) sont aussi relevées pour chaque trame
+verrouillée : elles mesurent l'efficacité du protocole sans carte, dans le banc de mesure ou un test.
+Les écritures sont sérialisées par un mutex : OE peut être découpée par le thread du moteur de luminosité
+pendant qu'une trame est envoyée.
+*/
+
+#ifndef GPIO_SIM_BACKEND_H
+#define GPIO_SIM_BACKEND_H
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include "GPIOBackend.h"
+
+/**
+* \struct CGPIOSimTiming
+* \brief Contraintes de temps de la chaine simulée par CGPIOSimBackend, en nanosecondes (0 : pas de contrôle)
+*/
+struct CGPIOSimTiming {
+	uint32_t writeNs = 100;		///< durée d'une opération d'écriture
+	uint32_t clockPeriodNs = 0;	///< période minimale de CLK
+	uint32_t setupNs = 0;		///< temps d'établissement de DATA avant le front montant de CLK
+	uint32_t holdNs = 0;		///< temps de maintien de DATA aprés le front montant de CLK
+};
+
+/**
+* \struct CGPIOSimStats
+* \brief Compteurs de la simulation d'une chaine de registres
+*/
+struct CGPIOSimStats {
+	uint64_t operations;		///< opérations d'écriture
+	uint64_t transitions;		///< changements d'état des broches de la chaine
+	uint64_t clocks;		///< fronts montants de CLK
+	uint64_t latches;		///< fronts montants de LE
+	uint64_t setupViolations;
+	uint64_t holdViolations;
+	uint64_t clockViolations;
+};
+
+class CGPIOSimBackend : public CGPIOBackend
+{
+public:
+	/**
+	* \brief Constructeur de la classe CGPIOSimBackend
+	* \param[in] nbAfficheurs Nombre de registres (un octet par afficheur) de la chaine
+	* \param[in] pinOE, pinLE, pinData, pinClk Numéros des broches reliées à la chaine
+	* \param[in] timing Contraintes de temps de la chaine
+	*/
+	CGPIOSimBackend(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk,
+	                const CGPIOSimTiming& timing = CGPIOSimTiming());
+
+	/**
+	* \brief Constructeur d'une chaine partagée en sous-chaines, une par ligne DATA
+	* \param[in] pinsData Numéros des lignes DATA, la première alimente les afficheurs les plus à gauche
+	*/
+	CGPIOSimBackend(int nbAfficheurs, int pinOE, int pinLE, const vector<int>& pinsData, int pinClk,
+	                const CGPIOSimTiming& timing = CGPIOSimTiming());
+
+	virtual bool exportPin(int num);
+	virtual bool unexportPin(int num);
+	virtual bool setDirection(int num, bool output);
+	virtual bool openValue(int num);
+	virtual void closeValue(int num);
+	virtual void writeValue(int num, bool high);
+	virtual void writeValues(const int* nums, size_t count, uint32_t setMask, uint32_t clearMask);
+	virtual bool readValue(int num, bool& high);
+
+	/// Segments présents sur les sorties de l'afficheur (0 : le plus à gauche, premier octet envoyé)
+	uint8_t getSegments(int afficheur) const;
+	/// Vrai si les sorties sont actives (OE à l'état bas)
+	bool isOutputEnabled() const;
+	/// Temps simulé écoulé depuis la création, en nanosecondes
+	uint64_t getTime() const;
+
+	/// Compteurs depuis la création (ou le dernier resetStats())
+	CGPIOSimStats getStats() const;
+	/// Compteurs de la dernière trame : entre les deux derniers fronts montants de LE
+	CGPIOSimStats getLastFrameStats() const;
+	void resetStats();
+
+private:
+	/// Rôle des broches dans la chaine : les lignes DATA suivent CLK (DATA + numéro de ligne)
+	enum Role { OE, LE, CLK, DATA, NONE = -1 };
+
+	int nbAfficheurs;
+	/// Nombre d'afficheurs d'une sous-chaine (la dernière peut être plus courte)
+	int longueur;
+	/// Numéros des broches, indexés par rôle
+	vector<int> pins;
+	CGPIOSimTiming timing;
+
+	/// Niveau de chaque broche de la chaine, indexé par rôle
+	vector<uint8_t> levels;
+	/// Niveaux aprés l'opération en cours, réutilisés d'une écriture à l'autre
+	vector<uint8_t> nextLevels;
+	/// Niveau des autres broches, indexé par numéro
+	vector<bool> others;
+
+	/// Registres de chaque sous-chaine (un bit par élément) : la position p est
+	/// bits[ligne][(head + p) % taille], le décalage se résume à déplacer 'head'
+	vector<vector<uint8_t>> bits;
+	size_t head;
+	/// Sorties verrouillées, une par afficheur
+	vector<uint8_t> outputs;
+
+	/// Dates en nanosecondes ; les événements qui n'ont pas encore eu lieu sont datés trés loin dans le passé
+	int64_t now;
+	int64_t dataChange;	///< date du dernier changement de DATA
+	int64_t clockRise;	///< date du dernier front montant de CLK
+	int64_t clockChange;	///< date du dernier changement de CLK
+
+	CGPIOSimStats stats;
+	CGPIOSimStats frameStart;
+	CGPIOSimStats lastFrame;
+
+	mutable std::mutex mutex;
+
+	/// Rôle de la broche : OE, LE, CLK, DATA + numéro de ligne ou NONE
+	int role(int num) const;
+	/**
+	* \brief Simule une opération d'écriture : les broches de la chaine prennent toutes les niveaux 'nextLevels' à la même date
+	*/
+	void step();
+	/// Transfère le contenu des registres sur les sorties
+	void latch();
+};
+
+#endif
@@ -0,0 +1,249 @@
+/**
+\file GPIOSysfsBackend.cpp
+
+\brief Implémentation de la classe CGPIOSysfsBackend (accés aux broches par sysfs)
+*/
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+
+#include "GPIOSysfsBackend.h"
+
+using namespace std;
+
+CGPIOSysfsBackend::CGPIOSysfsBackend(const string& root, std::chrono::milliseconds timeout)
+{
+	this->root = root;
+	this->timeout = timeout;
+}
+
+CGPIOSysfsBackend::~CGPIOSysfsBackend()
+{
+	for (int fd : values)
+		if (fd >= 0)
+			::close(fd);
+}
+
+bool CGPIOSysfsBackend::writeAttribute(const string& path, const string& text)
+{
+	int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	bool ok = (::write(fd, text.c_str(), text.size()) == (ssize_t)text.size());
+	::close(fd);
+	return ok;
+}
+
+string CGPIOSysfsBackend::pinPath(int num) const
+{
+	return root + "/gpio" + to_string(num);
+}
+
+bool CGPIOSysfsBackend::exportPin(int num)
+{
+	return exportPins(&num, 1);
+}
+
+bool CGPIOSysfsBackend::requestPins(const int* nums, size_t count, bool output, uint32_t highMask)
+{
+	return exportPins(nums, count);
+}
+
+bool CGPIOSysfsBackend::exportPins(const int* nums, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		// Broche déjà exportée (service redémarré, autre processus) : rien à écrire
+		if (::access(pinPath(nums[i]).c_str(), F_OK) == 0)
+			continue;
+
+		// EBUSY : la broche vient d'être exportée par ailleurs
+		if (!writeAttribute(root + "/export", to_string(nums[i])) &&
+		    !(errno == EBUSY && ::access(pinPath(nums[i]).c_str(), F_OK) == 0)) {
+			error = "OPERATION FAILED: Unable to export GPIO " + to_string(nums[i]) +
+				"\nMaybe you need to be root !\n";
+			return false;
+		}
+	}
+	return waitAttributes(nums, count);
+}
+
+bool CGPIOSysfsBackend::waitAttributes(const int* nums, size_t count)
+{
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	auto accessible = [this](int num) {
+		return ::access((pinPath(num) + "/direction").c_str(), W_OK) == 0 &&
+		       ::access((pinPath(num) + "/value").c_str(), W_OK) == 0;
+	};
+
+	// Cas courant (broches déjà prêtes ou processus root) : aucune surveillance
+	size_t ready = 0;
+	while (ready < count && accessible(nums[ready]))
+		ready++;
+	if (ready == count)
+		return true;
+
+	// La racine est surveillée pour l'apparition des répertoires gpioN
+	int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd >= 0)
+		::inotify_add_watch(fd, root.c_str(), IN_CREATE);
+
+	bool ok = true;
+	while (true) {
+		// Les surveillances sont posées avant de tester les droits : un changement
+		// fait par udev entre les deux ne peut pas être manqué. Poser de nouveau
+		// une surveillance existante ne fait rien
+		if (fd >= 0)
+			for (size_t i = ready; i < count; i++)
+				::inotify_add_watch(fd, pinPath(nums[i]).c_str(), IN_ATTRIB | IN_CREATE);
+
+		// Les broches prêtes ne sont plus testées
+		while (ready < count && accessible(nums[ready]))
+			ready++;
+		if (ready == count)
+			break;
+
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0) {
+			error = "OPERATION FAILED: Attributes of GPIO " + to_string(nums[ready]) +
+				" are not accessible\nMaybe you need to be root !\n";
+			ok = false;
+			break;
+		}
+
+		// Sans inotify, les droits sont testés de nouveau toutes les 10 ms
+		if (fd < 0) {
+			::usleep(std::min<long>(remaining, 10) * 1000);
+			continue;
+		}
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if (::poll(&pfd, 1, (int)remaining) > 0) {
+			char events[4096];
+			while (::read(fd, events, sizeof(events)) > 0)
+				;
+		}
+	}
+
+	if (fd >= 0)
+		::close(fd);
+	return ok;
+}
+
+bool CGPIOSysfsBackend::unexportPin(int num)
+{
+	if (!writeAttribute(root + "/unexport", to_string(num))) {
+		error = "OPERATION FAILED: Unable to unexport GPIO " + to_string(num) +
+			"\nMaybe you need to be root !\n";
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOSysfsBackend::setDirection(int num, bool output)
+{
+	string dirPath = pinPath(num) + "/direction";
+	if (!writeAttribute(dirPath, output ? "out" : "in")) {
+		error =  "OPERATION FAILED: Unable to set direction of GPIO " + to_string(num) +
+			     "\nMaybe you need to be root !\n";
+		return false;
+	}
+	return true;
+}
+
+bool CGPIOSysfsBackend::openValue(int num)
+{
+	string valPath = pinPath(num) + "/value";
+
+	closeValue(num);
+	int fd = ::open(valPath.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		error = "OPERATION FAILED: Unable to set the value of GPIO " + to_string(num) +
+			    "\nMaybe you need to be root !\n";
+		return false;
+	}
+
+	if ((size_t)num >= values.size())
+		values.resize(num + 1, -1);
+	values[num] = fd;
+	return true;
+}
+
+void CGPIOSysfsBackend::closeValue(int num)
+{
+	if (num < 0 || (size_t)num >= values.size() || values[num] < 0)
+		return;
+	::close(values[num]); // close value file
+	values[num] = -1;
+}
+
+void CGPIOSysfsBackend::writeValue(int num, bool high)
+{
+	// Un seul appel système, à la position 0 : sysfs n'a pas besoin de retour au début du fichier
+	::pwrite(values[num], high ? "1" : "0", 1, 0);
+}
+
+bool CGPIOSysfsBackend::readValue(int num, bool& high)
+{
+	if (num < 0 || (size_t)num >= values.size() || values[num] < 0) {
+		error = "OPERATION FAILED: GPIO " + to_string(num) + " is not opened";
+		return false;
+	}
+
+	char temp;
+	if (::pread(values[num], &temp, 1, 0) != 1) {
+		error = "OPERATION FAILED: Unable to read GPIO " + to_string(num) + " : " + strerror(errno) + "\n";
+		return false;
+	}
+	high = (temp != '0');
+	return true;
+}
+
+bool CGPIOSysfsBackend::setEdge(int num, CGPIOEdge edge)
+{
+	static const char* names[] = {"none", "rising", "falling", "both"};
+	if (!writeAttribute(pinPath(num) + "/edge", names[(int)edge])) {
+		error = "OPERATION FAILED: Unable to set edge of GPIO " + to_string(num) +
+			"\nMaybe the GPIO cant generate interrupts !\n";
+		return false;
+	}
+	return true;
+}
+
+int CGPIOSysfsBackend::getEdgeFd(int num, uint32_t& events)
+{
+	if (num < 0 || (size_t)num >= values.size())
+		return -1;
+	events = EPOLLPRI | EPOLLERR;
+	return values[num];
+}
+
+int CGPIOSysfsBackend::readEdges(int fd, CGPIOEvent* events, int max)
+{
+	if (max < 1)
+		return 0;
+	for (size_t num = 0; num < values.size(); num++) {
+		if (values[num] != fd)
+			continue;
+
+		// Un seul front par signalement : l'état courant, lu à la position 0
+		bool high;
+		if (!readValue(num, high))
+			return -1;
+		struct timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		events[0].num = num;
+		events[0].high = high;
+		events[0].timestamp = (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+		return 1;
+	}
+	error = "OPERATION FAILED: Unknown edge descriptor " + to_string(fd);
+	return -1;
+}
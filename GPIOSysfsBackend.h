@@ -0,0 +1,94 @@
+/**
+\file GPIOSysfsBackend.h
+Déclaration de la classe CGPIOSysfsBackend
+\class CGPIOSysfsBackend
+\brief Accés aux broches E/S TOR par le pseudo système de fichiers 'sysfs' (/sys/class/gpio)
+
+C'est la méthode historique de la classe CGPIO : elle fonctionne sur toutes les cartes dont
+le noyau propose l'interface sysfs mais chaque changement d'état d'une broche coûte une écriture
+dans un fichier. Un même objet peut servir à plusieurs broches, il conserve pour chacune d'elles
+le descripteur du fichier 'value' ouvert par openValue().
+
+Pour limiter le coût de chaque changement d'état, les fichiers sont manipulés directement par leur
+descripteur : une écriture est un unique appel pwrite() à la position 0, sans passer par les flux
+C++. La lecture utilise pread() à la position 0 et renvoie donc toujours l'état courant de la broche.
+
+L'initialisation est idempotente et ne dépend pas de délais arbitraires :
+- une broche déjà exportée (répertoire gpioN présent, par exemple aprés le redémarrage d'un
+  service qui ne l'a pas libérée) n'est pas exportée de nouveau ;
+- aprés l'exportation, les attributs 'direction' et 'value' ne sont pas toujours immédiatement
+  accessibles : udev en fixe les droits de son côté. Plutôt que de réessayer aprés des pauses,
+  la classe attend les changements de droits signalés par inotify, dans la limite d'un délai ;
+- requestPins() exporte toutes les broches d'un panneau puis attend leurs attributs ensemble,
+  les délais de udev se recouvrent au lieu de s'additionner.
+
+Les fronts sont choisis par l'attribut 'edge' : le fichier 'value' est alors signalé par POLLPRI
+à chaque front et la lecture de l'état courant réarme la détection. Le noyau ne date pas les fronts,
+la date est prise à la lecture.
+
+Le répertoire racine (/sys/class/gpio par défaut) est paramétrable : une arborescence factice
+(dans un tmpfs par exemple) permet de tester ou de mesurer les performances sans carte.
+*/
+
+#ifndef GPIO_SYSFS_BACKEND_H
+#define GPIO_SYSFS_BACKEND_H
+
+#include <vector>
+#include <chrono>
+#include "GPIOBackend.h"
+
+class CGPIOSysfsBackend : public CGPIOBackend
+{
+public:
+	/**
+	* \brief Constructeur de la classe CGPIOSysfsBackend
+	* \param[in] root Répertoire racine de l'interface sysfs (par défaut /sys/class/gpio)
+	* \param[in] timeout Délai maximal d'attente des attributs d'une broche exportée (1 s par défaut)
+	*/
+	CGPIOSysfsBackend(const string& root = "/sys/class/gpio",
+	                  std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+	virtual ~CGPIOSysfsBackend();
+
+	virtual bool exportPin(int num);
+	virtual bool requestPins(const int* nums, size_t count, bool output, uint32_t highMask = 0);
+	virtual bool unexportPin(int num);
+	virtual bool setDirection(int num, bool output);
+	virtual bool openValue(int num);
+	virtual void closeValue(int num);
+	virtual void writeValue(int num, bool high);
+	virtual bool readValue(int num, bool& high);
+	virtual bool setEdge(int num, CGPIOEdge edge);
+	virtual int getEdgeFd(int num, uint32_t& events);
+	virtual int readEdges(int fd, CGPIOEvent* events, int max);
+
+private:
+	/// Répertoire racine de l'interface sysfs (/sys/class/gpio)
+	string root;
+	/// Délai maximal d'attente des attributs aprés une exportation
+	std::chrono::milliseconds timeout;
+	/// Descripteurs des fichiers 'value' ouverts, indexés par numéro de broche (-1 si fermé)
+	vector<int> values;
+
+	/**
+	* \brief Ecrit une chaine dans un attribut sysfs (export, unexport, direction...)
+	* \return booléen qui indique si l'écriture a échoué (false) ou réussi (true)
+	*/
+	bool writeAttribute(const string& path, const string& text);
+
+	/**
+	* \brief Exporte les broches qui ne le sont pas déjà puis attend que leurs attributs soient accessibles
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool exportPins(const int* nums, size_t count);
+
+	/**
+	* \brief Attend (inotify) que les attributs 'direction' et 'value' des broches soient accessibles en écriture
+	* \return booléen qui indique si les attributs sont accessibles (true) ou si le délai a expiré (false)
+	*/
+	bool waitAttributes(const int* nums, size_t count);
+
+	/// Répertoire de la broche dans l'arborescence sysfs (gpioN)
+	string pinPath(int num) const;
+};
+
+#endif
@@ -0,0 +1,333 @@
+/*
+ * File:   Instrumentation.cpp
+ * Author: olivier
+ */
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include "Instrumentation.h"
+
+const int Instrumentation::nbBroches;
+const int Instrumentation::Histogramme::bitsSousClasses;
+const int Instrumentation::Histogramme::sousClasses;
+const int Instrumentation::Histogramme::exposantMax;
+const int Instrumentation::Histogramme::nbClasses;
+
+std::atomic<bool> Instrumentation::actif(false);
+
+static const int nbOperations = (int)Instrumentation::Operation::NbOperations;
+static const int nbErreurs = (int)Instrumentation::Erreur::NbErreurs;
+static const int nbLatences = (int)Instrumentation::Latence::NbLatences;
+
+static const char* nomsOperations[nbOperations] = {
+    "export", "unexport", "direction", "ouvertureValeur", "lecture", "trame", "trameEvitee"
+};
+static const char* nomsErreurs[nbErreurs] = {"gpio", "transport"};
+static const char* nomsLatences[nbLatences] = {
+    "export", "direction", "ouvertureValeur", "decalage", "verrouillage", "gigueFondu", "gigueBalayage"
+};
+
+namespace {
+
+// Compteurs d'un thread. Seul ce thread les modifie : un chargement suivi
+// d'un rangement suffit, les atomiques ne servent qu'à rendre la lecture
+// par snapshot() bien définie
+struct Compteurs {
+    struct Histogramme {
+        std::atomic<uint64_t> classes[Instrumentation::Histogramme::nbClasses];
+        std::atomic<uint64_t> nombre;
+        std::atomic<uint64_t> somme;
+        std::atomic<uint64_t> max;
+    };
+
+    std::atomic<uint64_t> ecrituresBroche[Instrumentation::nbBroches + 1];
+    std::atomic<uint64_t> operations[nbOperations];
+    std::atomic<uint64_t> erreurs[nbErreurs];
+    Histogramme latences[nbLatences];
+};
+
+inline void ajouter(std::atomic<uint64_t>& compteur, uint64_t n) {
+    compteur.store(compteur.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline uint64_t lire(const std::atomic<uint64_t>& compteur) {
+    return compteur.load(std::memory_order_relaxed);
+}
+
+// Compteurs de tous les threads vivants, et somme de ceux des threads
+// terminés. Le verrou n'est pris qu'à la création et à la fin d'un thread,
+// et par snapshot() / reset()
+struct Registre {
+    std::mutex mutex;
+    std::vector<Compteurs*> vivants;
+    Instrumentation::Releve termines;
+
+    Registre() {
+        memset(&termines, 0, sizeof(termines));
+    }
+};
+
+Registre& registre() {
+    static Registre r;
+    return r;
+}
+
+void cumuler(Instrumentation::Releve& releve, const Compteurs& c) {
+    for (int i=0; i<=Instrumentation::nbBroches; i++)
+        releve.ecrituresBroche[i] += lire(c.ecrituresBroche[i]);
+    for (int i=0; i<nbOperations; i++)
+        releve.operations[i] += lire(c.operations[i]);
+    for (int i=0; i<nbErreurs; i++)
+        releve.erreurs[i] += lire(c.erreurs[i]);
+    for (int l=0; l<nbLatences; l++) {
+        Instrumentation::Histogramme& h = releve.latences[l];
+        const Compteurs::Histogramme& source = c.latences[l];
+        for (int i=0; i<Instrumentation::Histogramme::nbClasses; i++)
+            h.classes[i] += lire(source.classes[i]);
+        h.nombre += lire(source.nombre);
+        h.somme += lire(source.somme);
+        h.max = std::max(h.max, lire(source.max));
+    }
+}
+
+void effacer(Compteurs& c) {
+    for (auto& a : c.ecrituresBroche)
+        a.store(0, std::memory_order_relaxed);
+    for (auto& a : c.operations)
+        a.store(0, std::memory_order_relaxed);
+    for (auto& a : c.erreurs)
+        a.store(0, std::memory_order_relaxed);
+    for (auto& h : c.latences) {
+        for (auto& a : h.classes)
+            a.store(0, std::memory_order_relaxed);
+        h.nombre.store(0, std::memory_order_relaxed);
+        h.somme.store(0, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Enregistrement des compteurs d'un thread, créé à sa première mesure
+struct Enregistrement {
+    Compteurs* compteurs;
+
+    Enregistrement() {
+        this->compteurs = new Compteurs();
+        Registre& r = registre();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.vivants.push_back(this->compteurs);
+    }
+
+    ~Enregistrement() {
+        Registre& r = registre();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            cumuler(r.termines, *this->compteurs);
+            r.vivants.erase(std::find(r.vivants.begin(), r.vivants.end(), this->compteurs));
+        }
+        delete this->compteurs;
+    }
+};
+
+Compteurs& locaux() {
+    thread_local Enregistrement enregistrement;
+    return *enregistrement.compteurs;
+}
+
+// Thread d'écriture périodique des relevés
+struct Dump {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread thread;
+    bool running = false;
+};
+
+Dump& dump() {
+    static Dump d;
+    return d;
+}
+
+}
+
+int Instrumentation::Histogramme::classe(uint64_t ns) {
+    if (ns < (uint64_t)sousClasses)
+        return (int)ns;
+    int exposant = 63 - __builtin_clzll(ns);
+    if (exposant >= exposantMax)
+        return nbClasses - 1;
+    int sousClasse = (ns >> (exposant - bitsSousClasses)) & (sousClasses - 1);
+    return sousClasses + (exposant - bitsSousClasses) * sousClasses + sousClasse;
+}
+
+uint64_t Instrumentation::Histogramme::borneInferieure(int c) {
+    if (c < sousClasses)
+        return c;
+    int exposant = (c - sousClasses) / sousClasses + bitsSousClasses;
+    uint64_t sousClasse = (c - sousClasses) % sousClasses;
+    return (sousClasses + sousClasse) << (exposant - bitsSousClasses);
+}
+
+uint64_t Instrumentation::Histogramme::percentile(double centile) const {
+    if (this->nombre == 0)
+        return 0;
+    uint64_t cible = std::max<uint64_t>(1, (uint64_t)std::ceil(this->nombre * centile / 100.0));
+    uint64_t cumul = 0;
+    for (int c=0; c<nbClasses; c++) {
+        cumul += this->classes[c];
+        if (cumul >= cible)
+            return borneInferieure(c);
+    }
+    return this->max;
+}
+
+double Instrumentation::Histogramme::moyenne() const {
+    return (this->nombre == 0) ? 0.0 : (double)this->somme / this->nombre;
+}
+
+void Instrumentation::Releve::ecrireJSON(ostream& os) const {
+    os << "{\n  \"broches\": {";
+    bool premier = true;
+    for (int i=0; i<=nbBroches; i++) {
+        if (this->ecrituresBroche[i] == 0)
+            continue;
+        os << (premier ? "" : ", ") << "\"" << (i < nbBroches ? to_string(i) : "autres") << "\": "
+           << this->ecrituresBroche[i];
+        premier = false;
+    }
+    os << "},\n  \"operations\": {";
+    for (int i=0; i<nbOperations; i++)
+        os << (i ? ", " : "") << "\"" << nomsOperations[i] << "\": " << this->operations[i];
+    os << "},\n  \"erreurs\": {";
+    for (int i=0; i<nbErreurs; i++)
+        os << (i ? ", " : "") << "\"" << nomsErreurs[i] << "\": " << this->erreurs[i];
+    os << "},\n  \"latences\": {";
+    for (int l=0; l<nbLatences; l++) {
+        const Histogramme& h = this->latences[l];
+        char ligne[256];
+        snprintf(ligne, sizeof(ligne),
+                 "%s\n    \"%s\": {\"nombre\": %llu, \"moyenne_ns\": %.1f, \"max_ns\": %llu, "
+                 "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu}",
+                 l ? "," : "", nomsLatences[l], (unsigned long long)h.nombre, h.moyenne(),
+                 (unsigned long long)h.max, (unsigned long long)h.percentile(50),
+                 (unsigned long long)h.percentile(90), (unsigned long long)h.percentile(99),
+                 (unsigned long long)h.percentile(99.9));
+        os << ligne;
+    }
+    os << "\n  }\n}\n";
+}
+
+void Instrumentation::enable(bool actif) {
+    Instrumentation::actif.store(actif, std::memory_order_relaxed);
+}
+
+void Instrumentation::ajouterEcritures(int pin, uint64_t n) {
+    int i = (pin >= 0 && pin < nbBroches) ? pin : nbBroches;
+    ajouter(locaux().ecrituresBroche[i], n);
+}
+
+void Instrumentation::ajouterSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n) {
+    uint64_t ecritures[32] = {0};
+    for (size_t k=0; k<n; k++) {
+        uint32_t masque = steps[k].setMask | steps[k].clearMask;
+        while (masque != 0) {
+            ecritures[__builtin_ctz(masque)]++;
+            masque &= masque - 1;
+        }
+    }
+    for (size_t i=0; i<count; i++) {
+        if (ecritures[i] != 0)
+            ajouterEcritures(nums[i], ecritures[i]);
+    }
+}
+
+void Instrumentation::ajouterOperation(Operation op) {
+    ajouter(locaux().operations[(int)op], 1);
+}
+
+void Instrumentation::ajouterErreur(Erreur e) {
+    ajouter(locaux().erreurs[(int)e], 1);
+}
+
+void Instrumentation::ajouterLatence(Latence l, uint64_t ns) {
+    Compteurs::Histogramme& h = locaux().latences[(int)l];
+    ajouter(h.classes[Histogramme::classe(ns)], 1);
+    ajouter(h.nombre, 1);
+    ajouter(h.somme, ns);
+    if (ns > lire(h.max))
+        h.max.store(ns, std::memory_order_relaxed);
+}
+
+void Instrumentation::snapshot(Releve& releve) {
+    Registre& r = registre();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    releve = r.termines;
+    for (const Compteurs* c : r.vivants)
+        cumuler(releve, *c);
+}
+
+void Instrumentation::reset() {
+    Registre& r = registre();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    memset(&r.termines, 0, sizeof(r.termines));
+    for (Compteurs* c : r.vivants)
+        effacer(*c);
+}
+
+bool Instrumentation::startDump(const string& fichier, std::chrono::milliseconds periode, string& erreur) {
+    if (periode.count() <= 0) {
+        erreur = "La période d\'écriture des relevés doit être positive";
+        return false;
+    }
+
+    stopDump();
+    Dump& d = dump();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.running = true;
+    try {
+        d.thread = std::thread([fichier, periode]() {
+            Dump& d = dump();
+            std::unique_ptr<Releve> releve(new Releve());
+            string temporaire = fichier + ".tmp";
+            auto echeance = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(d.mutex);
+            while (d.running) {
+                echeance += periode;
+                d.condition.wait_until(lock, echeance, [&d] { return !d.running; });
+                lock.unlock();
+                // Dernier relevé écrit aussi à l'arrêt
+                snapshot(*releve);
+                {
+                    ofstream os(temporaire, ios::trunc);
+                    releve->ecrireJSON(os);
+                }
+                std::rename(temporaire.c_str(), fichier.c_str());
+                lock.lock();
+            }
+        });
+    }
+    catch (std::system_error& e) {
+        d.running = false;
+        erreur = string("Impossible de lancer l\'écriture des relevés : ") + e.what();
+        return false;
+    }
+    return true;
+}
+
+void Instrumentation::stopDump() {
+    Dump& d = dump();
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (!d.running)
+            return;
+        d.running = false;
+    }
+    d.condition.notify_one();
+    d.thread.join();
+}
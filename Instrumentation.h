@@ -0,0 +1,177 @@
+/*
+ * File:   Instrumentation.h
+ * Author: olivier
+ *
+ * Instrumentation facultative des chemins critiques (CGPIO,
+ * PanneauAffichage, MoteurLuminosite, BalayageAffichage) pour savoir où
+ * passe le temps d'une mise à jour : exportation, direction, écritures
+ * des niveaux, fondus, balayage.
+ *
+ * Elle est désactivée par défaut (un seul test d'un booléen atomique par
+ * opération) et assez légère pour rester active en production :
+ * - chaque thread a ses propres compteurs (thread_local), qu'il est le
+ *   seul à modifier : pas de verrou ni d'instruction atomique verrouillée
+ *   sur le chemin critique ;
+ * - les latences sont rangées dans des histogrammes à classes
+ *   logarithmiques (à la manière de HdrHistogram : 16 sous-classes par
+ *   puissance de 2, soit une précision d'environ 6 %) ;
+ * - snapshot() additionne les compteurs de tous les threads, y compris
+ *   ceux des threads terminés ;
+ * - startDump() écrit périodiquement un relevé JSON dans un fichier
+ *   (remplacé atomiquement par rename()).
+ */
+
+#ifndef INSTRUMENTATION_H
+#define	INSTRUMENTATION_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <ctime>
+#include "GPIOBackend.h"
+
+using namespace std;
+
+class Instrumentation {
+public:
+    // Les broches de numéro supérieur ou égal sont comptées ensemble
+    static const int nbBroches = 512;
+
+    enum class Operation : uint8_t {
+        Export,
+        Unexport,
+        Direction,
+        OuvertureValeur,
+        Lecture,
+        Trame,          // trame envoyée sur la chaine
+        TrameEvitee,    // trame identique à celle déjà verrouillée
+        NbOperations
+    };
+
+    enum class Latence : uint8_t {
+        Export,         // exportPin() lors de CGPIO::init()
+        Direction,      // setDirection()
+        OuvertureValeur,// openValue()
+        Decalage,       // envoi d'une trame (séquence complète ou transport)
+        Verrouillage,   // impulsion sur LE après un transport
+        GigueFondu,     // retard du réveil du moteur de luminosité sur son échéance
+        GigueBalayage,  // retard du réveil du thread de balayage sur son échéance
+        NbLatences
+    };
+
+    enum class Erreur : uint8_t {
+        GPIO,           // opération CGPIO en échec
+        Transport,      // envoi refusé par le transport
+        NbErreurs
+    };
+
+    // Histogramme de durées en nanosecondes. Les valeurs inférieures à 16
+    // ont chacune leur classe, au-delà chaque puissance de 2 est découpée
+    // en 16 classes (jusqu'à 2^40 ns, soit environ 18 minutes)
+    struct Histogramme {
+        static const int bitsSousClasses = 4;
+        static const int sousClasses = 1 << bitsSousClasses;
+        static const int exposantMax = 40;
+        static const int nbClasses = sousClasses + (exposantMax - bitsSousClasses) * sousClasses;
+
+        uint64_t classes[nbClasses];
+        uint64_t nombre;
+        uint64_t somme;
+        uint64_t max;
+
+        static int classe(uint64_t ns);
+        // Plus petite valeur rangée dans la classe 'c'
+        static uint64_t borneInferieure(int c);
+        // Valeur (borne inférieure de classe) sous laquelle se trouvent
+        // 'centile' % des mesures, 0 si l'histogramme est vide
+        uint64_t percentile(double centile) const;
+        double moyenne() const;
+    };
+
+    // Relevé de tous les compteurs à un instant donné
+    struct Releve {
+        uint64_t ecrituresBroche[nbBroches + 1];
+        uint64_t operations[(int)Operation::NbOperations];
+        uint64_t erreurs[(int)Erreur::NbErreurs];
+        Histogramme latences[(int)Latence::NbLatences];
+
+        // Objet JSON : broches écrites, opérations, erreurs et, pour chaque
+        // latence, nombre, moyenne, max et centiles 50/90/99/99.9
+        void ecrireJSON(ostream& os) const;
+    };
+
+    static void enable(bool actif = true);
+    static bool isEnabled() {
+        return actif.load(std::memory_order_relaxed);
+    }
+
+    // Chemin critique : ne font rien si l'instrumentation est désactivée
+    static void countWrite(int pin, uint64_t n = 1) {
+        if (isEnabled())
+            ajouterEcritures(pin, n);
+    }
+    // Ecritures d'une séquence rejouée par CGPIOBackend::writeSequence()
+    static void countSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n) {
+        if (isEnabled())
+            ajouterSequence(nums, count, steps, n);
+    }
+    static void countOperation(Operation op) {
+        if (isEnabled())
+            ajouterOperation(op);
+    }
+    static void countError(Erreur e) {
+        if (isEnabled())
+            ajouterErreur(e);
+    }
+    static void recordLatency(Latence l, uint64_t ns) {
+        if (isEnabled())
+            ajouterLatence(l, ns);
+    }
+
+    // Horloge monotone en nanosecondes
+    static uint64_t now() {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+    }
+
+    // Mesure la durée de sa portée (rien si l'instrumentation est désactivée
+    // à sa construction)
+    class Chrono {
+    public:
+        Chrono(Latence latence) : latence(latence), debut(isEnabled() ? now() : 0) {}
+        ~Chrono() {
+            if (debut != 0)
+                ajouterLatence(latence, now() - debut);
+        }
+    private:
+        Latence latence;
+        uint64_t debut;
+    };
+
+    // Somme des compteurs de tous les threads. Sans synchronisation avec
+    // les threads instrumentés : une opération en cours peut manquer
+    static void snapshot(Releve& releve);
+    // Remise à zéro de tous les compteurs
+    static void reset();
+
+    // Ecrit un relevé JSON dans 'fichier' à chaque période, par un thread
+    // dédié. Renvoie false (avec un message dans 'erreur') si le thread ne
+    // peut être lancé
+    static bool startDump(const string& fichier, std::chrono::milliseconds periode, string& erreur);
+    static void stopDump();
+
+private:
+    static std::atomic<bool> actif;
+
+    static void ajouterEcritures(int pin, uint64_t n);
+    static void ajouterSequence(const int* nums, size_t count, const CGPIOStep* steps, size_t n);
+    static void ajouterOperation(Operation op);
+    static void ajouterErreur(Erreur e);
+    static void ajouterLatence(Latence l, uint64_t ns);
+};
+
+#endif	/* INSTRUMENTATION_H */
+
@@ -0,0 +1,226 @@
+/*
+ * File:   MoteurLuminosite.cpp
+ * Author: olivier
+ */
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include "MoteurLuminosite.h"
+#include "Instrumentation.h"
+
+const int MoteurLuminosite::luminositeMax;
+constexpr double MoteurLuminosite::gamma;
+
+static void addNs(struct timespec& t, long ns) {
+    t.tv_nsec += ns;
+    while (t.tv_nsec >= 1000000000L) {
+        t.tv_nsec -= 1000000000L;
+        t.tv_sec++;
+    }
+}
+
+MoteurLuminosite::MoteurLuminosite(CGPIO* oe, CPWM* pwm, std::chrono::microseconds periode) {
+    this->oe = oe;
+    this->pwm = pwm;
+    this->niveauPWM = -1;
+    this->periodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(periode).count();
+    for (int i=0; i<=luminositeMax; i++)
+        this->table[i] = (uint16_t)std::lround(65535.0 * std::pow((double)i / luminositeMax, gamma));
+    this->running = false;
+    this->changed = false;
+    this->level = 0;
+}
+
+MoteurLuminosite::~MoteurLuminosite() {
+    stop();
+}
+
+void MoteurLuminosite::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running)
+        return;
+    running = true;
+    changed = true;
+    thread = std::thread(&MoteurLuminosite::run, this);
+}
+
+void MoteurLuminosite::stop() {
+    Fondu termine;
+    bool wasRunning;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wasRunning = running;
+        running = false;
+        termine = std::move(fondu);
+        fondu.actif = false;
+    }
+    if (wasRunning) {
+        condition.notify_one();
+        thread.join();
+    }
+    complete(termine);
+}
+
+void MoteurLuminosite::setBrightness(int level) {
+    Fondu termine;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->level = std::min(std::max(level, 0), luminositeMax);
+        termine = std::move(fondu);
+        fondu.actif = false;
+        changed = true;
+    }
+    condition.notify_one();
+    complete(termine);
+}
+
+int MoteurLuminosite::getBrightness() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return this->level;
+}
+
+std::future<void> MoteurLuminosite::fadeTo(int level, std::chrono::milliseconds duration,
+                                           std::function<void()> onDone) {
+    level = std::min(std::max(level, 0), luminositeMax);
+    if (duration.count() <= 0) {
+        setBrightness(level);
+        std::promise<void> p;
+        p.set_value();
+        if (onDone)
+            onDone();
+        return p.get_future();
+    }
+
+    Fondu termine;
+    std::future<void> f;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        termine = std::move(fondu);
+        fondu.actif = true;
+        fondu.depart = this->level;
+        fondu.cible = level;
+        fondu.debut = horloge::now();
+        fondu.fin = fondu.debut + duration;
+        fondu.promesse = std::promise<void>();
+        fondu.rappel = onDone;
+        f = fondu.promesse.get_future();
+        changed = true;
+    }
+    condition.notify_one();
+    complete(termine);
+    return f;
+}
+
+void MoteurLuminosite::complete(Fondu& f) {
+    if (!f.actif)
+        return;
+    f.actif = false;
+    f.promesse.set_value();
+    if (f.rappel)
+        f.rappel();
+}
+
+int MoteurLuminosite::update(horloge::time_point now, Fondu& termine) {
+    if (!fondu.actif)
+        return level;
+
+    if (now >= fondu.fin) {
+        level = fondu.cible;
+        termine = std::move(fondu);
+        fondu.actif = false;
+        return level;
+    }
+
+    auto ecoule = std::chrono::duration_cast<std::chrono::microseconds>(now - fondu.debut).count();
+    auto total = std::chrono::duration_cast<std::chrono::microseconds>(fondu.fin - fondu.debut).count();
+    level = fondu.depart + (int)((fondu.cible - fondu.depart) * ecoule / total);
+    return level;
+}
+
+void MoteurLuminosite::apply(int current) {
+    if (pwm != nullptr) {
+        // OE est active à l'état bas : la durée de l'état haut est la part éteinte
+        if (current != niveauPWM) {
+            uint64_t allume = (uint64_t)pwm->getPeriod() * table[current] / 65535;
+            pwm->setDuty(pwm->getPeriod() - (uint32_t)allume);
+            niveauPWM = current;
+        }
+    }
+    else if (current == 0)
+        oe->fixHigh();
+    else if (current == luminositeMax)
+        oe->fixLow();
+}
+
+void MoteurLuminosite::sleepUntil(const struct timespec& deadline) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+        ;
+    // Retard du réveil sur l'échéance (gigue de la MLI et des pas de fondu)
+    if (Instrumentation::isEnabled()) {
+        uint64_t echeance = (uint64_t)deadline.tv_sec * 1000000000ULL + deadline.tv_nsec;
+        uint64_t maintenant = Instrumentation::now();
+        Instrumentation::recordLatency(Instrumentation::Latence::GigueFondu,
+                                       maintenant > echeance ? maintenant - echeance : 0);
+    }
+}
+
+void MoteurLuminosite::run() {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        Fondu termine;
+        int current = update(horloge::now(), termine);
+        bool fading = fondu.actif;
+        changed = false;
+
+        if (termine.actif) {
+            lock.unlock();
+            complete(termine);
+            lock.lock();
+            continue;
+        }
+
+        // Niveau fixe (éteint ou maximal en MLI logicielle, quelconque en MLI
+        // matérielle) : la sortie est positionnée une fois pour toutes et le
+        // thread dort jusqu'à la prochaine commande
+        if (!fading && (pwm != nullptr || current == 0 || current == luminositeMax)) {
+            apply(current);
+            condition.wait(lock, [this] { return !running || changed; });
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            continue;
+        }
+        
+        // Fondu en MLI matérielle : une écriture par pas de luminosité
+        if (pwm != nullptr) {
+            lock.unlock();
+            apply(current);
+            addNs(deadline, periodeNs);
+            sleepUntil(deadline);
+            lock.lock();
+            continue;
+        }
+
+        // Une période de MLI : OE à l'état bas pendant la fraction 'current'.
+        // Si le thread a pris plus d'une période de retard, les échéances
+        // repartent de maintenant plutôt que d'enchainer des périodes tronquées
+        lock.unlock();
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - deadline.tv_sec) * 1000000000L + (now.tv_nsec - deadline.tv_nsec) > periodeNs)
+            deadline = now;
+        long on = (long)((int64_t)periodeNs * table[current] / 65535);
+        if (on > 0)
+            oe->fixLow();
+        if (on < periodeNs) {
+            struct timespec off = deadline;
+            addNs(off, on);
+            sleepUntil(off);
+            oe->fixHigh();
+        }
+        addNs(deadline, periodeNs);
+        sleepUntil(deadline);
+        lock.lock();
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * File:   MoteurLuminosite.h
+ * Author: olivier
+ *
+ * Moteur de luminosité d'un panneau : la broche OE (active à l'état bas)
+ * est pilotée en MLI (PWM) logicielle par un thread dédié, réveillé à
+ * échéances absolues par clock_nanosleep(TIMER_ABSTIME). Les fondus sont
+ * calculés par ce thread : fadeTo() rend la main immédiatement et signale
+ * la fin du fondu par un std::future et/ou une fonction de rappel.
+ *
+ * Aux niveaux extrêmes (éteint ou luminosité maximale) le thread est
+ * endormi et ne consomme rien.
+ *
+ * Si une sortie MLI matérielle (CPWM) est fournie, OE n'est plus découpée
+ * par le thread : chaque pas de luminosité se traduit par une seule
+ * écriture du rapport cyclique. Dans les deux cas la luminosité passe par
+ * une table de correction gamma précalculée, pour que les fondus soient
+ * perçus comme réguliers.
+ */
+
+#ifndef MOTEURLUMINOSITE_H
+#define	MOTEURLUMINOSITE_H
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
+#include "GPIOClass.h"
+#include "PWMSysfs.h"
+
+class MoteurLuminosite {
+public:
+    // Niveaux de luminosité de 0 (éteint) à luminositeMax (sorties toujours actives)
+    static const int luminositeMax = 100;
+
+    // Coefficient de la correction gamma appliquée aux niveaux
+    static constexpr double gamma = 2.2;
+
+    // oe : broche OE pilotée en MLI logicielle (inutilisée si pwm est fourni)
+    // pwm : sortie MLI matérielle reliée à OE, déjà initialisée, ou nullptr
+    // periode : période de la MLI logicielle (5 ms, soit 200 Hz, par défaut),
+    // et intervalle entre deux pas d'un fondu en MLI matérielle
+    MoteurLuminosite(CGPIO* oe, CPWM* pwm = nullptr,
+                     std::chrono::microseconds periode = std::chrono::microseconds(5000));
+    virtual ~MoteurLuminosite();
+
+    void start();
+    void stop();
+
+    // Fixe immédiatement la luminosité, un fondu en cours est interrompu
+    void setBrightness(int level);
+    int getBrightness();
+
+    // Lance un fondu linéaire vers 'level' en 'duration' et rend la main
+    // immédiatement. Le future (et la fonction de rappel, appelée depuis le
+    // thread du moteur) signale la fin du fondu, ou son interruption par un
+    // nouvel appel à setBrightness() ou fadeTo().
+    std::future<void> fadeTo(int level, std::chrono::milliseconds duration,
+                             std::function<void()> onDone = nullptr);
+
+private:
+    typedef std::chrono::steady_clock horloge;
+
+    struct Fondu {
+        bool actif = false;
+        int depart;
+        int cible;
+        horloge::time_point debut;
+        horloge::time_point fin;
+        std::promise<void> promesse;
+        std::function<void()> rappel;
+    };
+
+    CGPIO* oe;
+    CPWM* pwm;
+    long periodeNs;
+    // Fraction du temps où les sorties sont actives pour chaque niveau,
+    // sur 16 bits (0 : toujours éteint, 65535 : toujours allumé)
+    uint16_t table[luminositeMax + 1];
+    // Dernier niveau écrit sur la sortie matérielle (-1 : aucun)
+    int niveauPWM;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool running;
+    bool changed;
+    int level;
+    Fondu fondu;
+
+    void run();
+    // Calcule le niveau courant, termine le fondu s'il est arrivé à son terme
+    // (le fondu terminé est transféré dans 'termine' pour être signalé hors verrou)
+    int update(horloge::time_point now, Fondu& termine);
+    // Applique un niveau fixe : une écriture du rapport cyclique ou OE statique
+    void apply(int current);
+    static void complete(Fondu& f);
+    static void sleepUntil(const struct timespec& deadline);
+};
+
+#endif	/* MOTEURLUMINOSITE_H */
+
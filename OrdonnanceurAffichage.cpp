@@ -0,0 +1,213 @@
+/*
+ * File:   OrdonnanceurAffichage.cpp
+ * Author: olivier
+ */
+#include <algorithm>
+#include "OrdonnanceurAffichage.h"
+#include "PanneauAffichage.h"
+
+static thread_local OrdonnanceurAffichage* actuel = nullptr;
+
+std::coroutine_handle<> Tache::Fin::await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+    promise_type& p = h.promise();
+    if (p.suite)
+        return p.suite;
+    if (p.ordonnanceur != nullptr)
+        p.ordonnanceur->terminer(h);
+    return std::noop_coroutine();
+}
+
+Tache& Tache::operator=(Tache&& autre) noexcept {
+    if (this != &autre) {
+        if (this->coroutine)
+            this->coroutine.destroy();
+        this->coroutine = std::exchange(autre.coroutine, nullptr);
+    }
+    return *this;
+}
+
+Tache::~Tache() {
+    if (this->coroutine)
+        this->coroutine.destroy();
+}
+
+void Delai::await_suspend(std::coroutine_handle<> h) {
+    OrdonnanceurAffichage* ordonnanceur = OrdonnanceurAffichage::courant();
+    if (ordonnanceur == nullptr)
+        throw (PanneauAffichage::Erreur("Une attente doit être exécutée par un ordonnanceur"));
+    ordonnanceur->programmer(h, this->duree);
+}
+
+void EvenementAffichage::signal() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->signale = true;
+    if (this->coroutine)
+        this->ordonnanceur->post(this->coroutine);
+    this->coroutine = nullptr;
+}
+
+bool EvenementAffichage::attendre(std::coroutine_handle<> h) {
+    OrdonnanceurAffichage* ordonnanceur = OrdonnanceurAffichage::courant();
+    if (ordonnanceur == nullptr)
+        throw (PanneauAffichage::Erreur("Une attente doit être exécutée par un ordonnanceur"));
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->signale)
+        return false;
+    this->coroutine = h;
+    this->ordonnanceur = ordonnanceur;
+    return true;
+}
+
+void EvenementAffichage::abandonner() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->coroutine = nullptr;
+}
+
+AttenteFondu::~AttenteFondu() {
+    // Coroutine détruite pendant le fondu (arrêt de l'ordonnanceur) : la fin
+    // du fondu ne doit plus la reprendre
+    if (this->evenement)
+        this->evenement->abandonner();
+}
+
+OrdonnanceurAffichage::OrdonnanceurAffichage() {
+    this->origine = horloge::now();
+    this->tick = 0;
+    this->nbMinuteries = 0;
+    this->arret = false;
+}
+
+OrdonnanceurAffichage::~OrdonnanceurAffichage() {
+    // Détruire une racine détruit aussi les taches qu'elle attendait
+    for (auto h : this->racines)
+        h.destroy();
+    for (auto h : this->terminees)
+        h.destroy();
+}
+
+void OrdonnanceurAffichage::spawn(Tache tache) {
+    std::coroutine_handle<Tache::promise_type> h = std::exchange(tache.coroutine, nullptr);
+    if (!h)
+        return;
+    h.promise().ordonnanceur = this;
+    this->racines.push_back(h);
+    this->pretes.push_back(h);
+}
+
+size_t OrdonnanceurAffichage::size() const {
+    return this->racines.size();
+}
+
+OrdonnanceurAffichage* OrdonnanceurAffichage::courant() {
+    return actuel;
+}
+
+void OrdonnanceurAffichage::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->arret = true;
+    }
+    this->condition.notify_one();
+}
+
+void OrdonnanceurAffichage::post(std::coroutine_handle<> h) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->deposees.push_back(h);
+    }
+    this->condition.notify_one();
+}
+
+uint64_t OrdonnanceurAffichage::maintenant() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(horloge::now() - this->origine).count();
+}
+
+void OrdonnanceurAffichage::programmer(std::coroutine_handle<> h, std::chrono::milliseconds duree) {
+    // Au moins la case suivante : la case courante est déjà traitée
+    uint64_t echeance = std::max(maintenant() + duree.count(), this->tick + 1);
+    this->roue[echeance % nbCases].push_back({h, echeance});
+    this->nbMinuteries++;
+}
+
+void OrdonnanceurAffichage::avancer() {
+    uint64_t t = maintenant();
+    while (this->tick < t && this->nbMinuteries != 0) {
+        this->tick++;
+        // Une case contient aussi les échéances des tours suivants
+        vector<Minuterie>& c = this->roue[this->tick % nbCases];
+        auto fin = std::partition(c.begin(), c.end(), [this](const Minuterie& m) {
+            return m.echeance > this->tick;
+        });
+        for (auto it = fin; it != c.end(); ++it)
+            this->pretes.push_back(it->coroutine);
+        this->nbMinuteries -= c.end() - fin;
+        c.erase(fin, c.end());
+    }
+    // Sans minuterie, la roue est déjà à jour
+    this->tick = std::max(this->tick, t);
+}
+
+void OrdonnanceurAffichage::attendre() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto reveil = [this]() { return !this->deposees.empty() || this->arret; };
+    if (this->nbMinuteries == 0) {
+        this->condition.wait(lock, reveil);
+        return;
+    }
+    // Prochaine case occupée, au plus un tour plus loin
+    uint64_t t = this->tick + 1;
+    while (t < this->tick + nbCases && this->roue[t % nbCases].empty())
+        t++;
+    this->condition.wait_until(lock, this->origine + std::chrono::milliseconds(t), reveil);
+}
+
+void OrdonnanceurAffichage::terminer(std::coroutine_handle<Tache::promise_type> h) {
+    this->racines.erase(std::find(this->racines.begin(), this->racines.end(), h));
+    this->terminees.push_back(h);
+}
+
+void OrdonnanceurAffichage::nettoyer() {
+    std::exception_ptr exception;
+    for (auto h : this->terminees) {
+        if (!exception)
+            exception = h.promise().exception;
+        h.destroy();
+    }
+    this->terminees.clear();
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void OrdonnanceurAffichage::run() {
+    struct Contexte {
+        OrdonnanceurAffichage* precedent;
+        Contexte(OrdonnanceurAffichage* o) : precedent(actuel) { actuel = o; }
+        ~Contexte() { actuel = precedent; }
+    } contexte(this);
+
+    while (!this->racines.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->arret) {
+                this->arret = false;
+                return;
+            }
+            while (!this->deposees.empty()) {
+                this->pretes.push_back(this->deposees.front());
+                this->deposees.pop_front();
+            }
+        }
+
+        avancer();
+        if (this->pretes.empty()) {
+            attendre();
+            continue;
+        }
+        while (!this->pretes.empty()) {
+            std::coroutine_handle<> h = this->pretes.front();
+            this->pretes.pop_front();
+            h.resume();
+            nettoyer();
+        }
+    }
+}
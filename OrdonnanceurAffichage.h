@@ -0,0 +1,227 @@
+/*
+ * File:   OrdonnanceurAffichage.h
+ * Author: olivier
+ *
+ * Scénarios d'affichage écrits comme des coroutines C++20, exécutés par un
+ * seul thread : autant de panneaux que nécessaire sont animés en même
+ * temps, sans sleep() ni thread par panneau.
+ *
+ *   Tache annonce(PanneauAffichage& panneau) {
+ *       for (int i=0; i<10; i++) {
+ *           co_await panneau.show("HELLO", std::chrono::milliseconds(500));
+ *           co_await panneau.fadeTo(0, std::chrono::seconds(1));
+ *           co_await after(std::chrono::seconds(2));
+ *       }
+ *   }
+ *
+ *   OrdonnanceurAffichage ordonnanceur;
+ *   ordonnanceur.spawn(annonce(panneau1));
+ *   ordonnanceur.spawn(annonce(panneau2));
+ *   ordonnanceur.run();
+ *
+ * Une Tache ne démarre que lorsqu'elle est confiée à l'ordonnanceur
+ * (spawn()) ou attendue par une autre tache (co_await) ; ses exceptions
+ * sont transmises à la tache qui l'attend, ou levées par run().
+ *
+ * Les attentes sont rangées dans une roue temporelle d'une case par
+ * milliseconde : programmer ou déclencher une attente coûte la même chose
+ * quel que soit leur nombre, et le thread dort jusqu'à la prochaine case
+ * occupée. Les fins de fondu, signalées par le thread du moteur de
+ * luminosité, sont déposées dans une file protégée par un verrou : ce sont
+ * les seules opérations qui viennent d'un autre thread.
+ */
+
+#ifndef ORDONNANCEURAFFICHAGE_H
+#define	ORDONNANCEURAFFICHAGE_H
+
+#include <cstdint>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class OrdonnanceurAffichage;
+
+// Coroutine d'un scénario (co_await sur les attentes ci-dessous, et sur
+// d'autres taches)
+class Tache {
+public:
+    struct promise_type;
+
+    struct Fin {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type {
+        std::coroutine_handle<> suite;              // tache qui attend celle-ci
+        OrdonnanceurAffichage* ordonnanceur = nullptr;  // tache racine (spawn())
+        std::exception_ptr exception;
+
+        Tache get_return_object() {
+            return Tache(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        Fin final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    struct Attente {
+        std::coroutine_handle<promise_type> coroutine;
+
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> suite) noexcept {
+            coroutine.promise().suite = suite;
+            return coroutine;
+        }
+        void await_resume() {
+            if (coroutine.promise().exception)
+                std::rethrow_exception(coroutine.promise().exception);
+        }
+    };
+
+    Tache(Tache&& autre) noexcept : coroutine(std::exchange(autre.coroutine, nullptr)) {}
+    Tache& operator=(Tache&& autre) noexcept;
+    Tache(const Tache&) = delete;
+    Tache& operator=(const Tache&) = delete;
+    ~Tache();
+
+    Attente operator co_await() && noexcept {
+        return Attente{coroutine};
+    }
+
+private:
+    friend class OrdonnanceurAffichage;
+    std::coroutine_handle<promise_type> coroutine;
+
+    explicit Tache(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+};
+
+// Attente d'une durée (co_await after(...))
+class Delai {
+public:
+    explicit Delai(std::chrono::milliseconds duree) : duree(duree) {}
+
+    bool await_ready() const noexcept { return duree.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume() const noexcept {}
+
+private:
+    std::chrono::milliseconds duree;
+};
+
+inline Delai after(std::chrono::milliseconds duree) {
+    return Delai(duree);
+}
+
+// Evénement signalé une seule fois, depuis n'importe quel thread, et attendu
+// par une coroutine
+class EvenementAffichage {
+public:
+    void signal();
+    // Renvoie false (sans suspendre) si l'événement est déjà signalé
+    bool attendre(std::coroutine_handle<> h);
+    // La coroutine qui attendait est détruite : elle ne sera pas reprise
+    void abandonner();
+
+private:
+    std::mutex mutex;
+    bool signale = false;
+    std::coroutine_handle<> coroutine;
+    OrdonnanceurAffichage* ordonnanceur = nullptr;
+};
+
+// Fondu en cours (voir PanneauAffichage::fadeTo()) : un std::future comme
+// auparavant, que l'on peut aussi attendre par co_await
+class AttenteFondu : public std::future<void> {
+public:
+    AttenteFondu(std::future<void>&& f, std::shared_ptr<EvenementAffichage> evenement)
+        : std::future<void>(std::move(f)), evenement(std::move(evenement)) {}
+    AttenteFondu(AttenteFondu&&) = default;
+    ~AttenteFondu();
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) { return evenement->attendre(h); }
+    void await_resume() { get(); }
+
+private:
+    std::shared_ptr<EvenementAffichage> evenement;
+};
+
+class OrdonnanceurAffichage {
+public:
+    // Cases de la roue, d'une milliseconde chacune
+    static const int nbCases = 512;
+
+    OrdonnanceurAffichage();
+    // Les taches non terminées sont détruites sans être reprises
+    virtual ~OrdonnanceurAffichage();
+
+    // Confie une tache à l'ordonnanceur, elle démarre au prochain run()
+    void spawn(Tache tache);
+
+    // Exécute les taches dans le thread appelant jusqu'à ce qu'elles soient
+    // toutes terminées ou que stop() soit appelé. Lève l'exception non
+    // rattrapée d'une tache racine (les autres taches continuent au
+    // prochain appel)
+    void run();
+    // Depuis n'importe quel thread
+    void stop();
+
+    // Taches racines non terminées
+    size_t size() const;
+
+    // Ordonnanceur qui exécute le thread appelant (nullptr hors de run())
+    static OrdonnanceurAffichage* courant();
+
+    // Reprise de 'h' dans 'duree', depuis le thread de run()
+    void programmer(std::coroutine_handle<> h, std::chrono::milliseconds duree);
+    // Reprise de 'h' dès que possible, depuis n'importe quel thread
+    void post(std::coroutine_handle<> h);
+
+private:
+    typedef std::chrono::steady_clock horloge;
+
+    struct Minuterie {
+        std::coroutine_handle<> coroutine;
+        uint64_t echeance;      // en millisecondes depuis 'origine'
+    };
+
+    horloge::time_point origine;
+    uint64_t tick;              // dernière case traitée
+    vector<Minuterie> roue[nbCases];
+    size_t nbMinuteries;
+
+    std::deque<std::coroutine_handle<>> pretes;
+    vector<std::coroutine_handle<Tache::promise_type>> racines;
+    vector<std::coroutine_handle<Tache::promise_type>> terminees;
+
+    // Dépôts des autres threads
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::coroutine_handle<>> deposees;
+    bool arret;
+
+    friend struct Tache::Fin;
+    void terminer(std::coroutine_handle<Tache::promise_type> h);
+    // Détruit les taches racines terminées, lève la première exception
+    void nettoyer();
+    uint64_t maintenant() const;
+    // Déclenche les minuteries arrivées à échéance
+    void avancer();
+    // Attend la prochaine case occupée ou un dépôt
+    void attendre();
+};
+
+#endif	/* ORDONNANCEURAFFICHAGE_H */
+
@@ -0,0 +1,154 @@
+/**
+\file PWMSysfs.cpp
+
+\brief Implémentation de la classe CPWM (MLI matérielle par /sys/class/pwm)
+*/
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "PWMSysfs.h"
+
+using namespace std;
+
+CPWM::CPWM(int chip, int channel, uint32_t periodNs, const string& root)
+{
+	this->chip = chip;
+	this->channel = channel;
+	this->periodNs = periodNs;
+	this->chipPath = root + "/pwmchip" + to_string(chip);
+	this->channelPath = chipPath + "/pwm" + to_string(channel);
+	this->dutyFd = -1;
+	this->exported = false;
+}
+
+CPWM::~CPWM()
+{
+	if (dutyFd >= 0)
+		::close(dutyFd);
+}
+
+bool CPWM::writeAttribute(const string& path, const string& text)
+{
+	int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+	if (fd < 0) {
+		error = "OPERATION FAILED: Unable to open " + path + " : " + strerror(errno) + "\n";
+		return false;
+	}
+
+	bool ok = (::write(fd, text.c_str(), text.size()) == (ssize_t)text.size());
+	if (!ok)
+		error = "OPERATION FAILED: Unable to write " + path + " : " + strerror(errno) + "\n";
+	::close(fd);
+	return ok;
+}
+
+bool CPWM::exists()
+{
+	if (chip < 0 || channel < 0)
+		return false;
+
+	// Le fichier npwm donne le nombre de canaux de la puce
+	FILE* f = fopen((chipPath + "/npwm").c_str(), "r");
+	if (f == nullptr)
+		return false;
+	int npwm = 0;
+	bool ok = (fscanf(f, "%d", &npwm) == 1 && channel < npwm);
+	fclose(f);
+	return ok;
+}
+
+bool CPWM::init()
+{
+	if (dutyFd >= 0)
+		return true;
+
+	if (!exists()) {
+		error = "OPERATION FAILED: PWM channel " + to_string(channel) + " of pwmchip" + to_string(chip) +
+			" does not exist\n";
+		return false;
+	}
+
+	struct stat st;
+	if (stat(channelPath.c_str(), &st) != 0) {
+		if (!writeAttribute(chipPath + "/export", to_string(channel)))
+			return false;
+		exported = true;
+	}
+
+	// Rapport cyclique à zéro avant la période : le noyau refuse une période
+	// plus courte que le rapport cyclique en cours. La sortie est ensuite
+	// activée à l'état haut pendant toute la période : sur OE (active à
+	// l'état bas), le panneau reste éteint jusqu'au premier réglage
+	if (!writeAttribute(channelPath + "/duty_cycle", "0") ||
+	    !writeAttribute(channelPath + "/period", to_string(periodNs)) ||
+	    !writeAttribute(channelPath + "/duty_cycle", to_string(periodNs)) ||
+	    !writeAttribute(channelPath + "/enable", "1")) {
+		unexportChannel();
+		return false;
+	}
+
+	dutyFd = ::open((channelPath + "/duty_cycle").c_str(), O_WRONLY | O_CLOEXEC);
+	if (dutyFd < 0) {
+		error = "OPERATION FAILED: Unable to open " + channelPath + "/duty_cycle : " + strerror(errno) + "\n";
+		writeAttribute(channelPath + "/enable", "0");
+		unexportChannel();
+		return false;
+	}
+	return true;
+}
+
+void CPWM::unexportChannel()
+{
+	// Le message d'erreur de l'étape qui a échoué est conservé
+	if (exported) {
+		exported = false;
+		string erreur = error;
+		writeAttribute(chipPath + "/unexport", to_string(channel));
+		error = erreur;
+	}
+}
+
+bool CPWM::close()
+{
+	if (dutyFd >= 0) {
+		::close(dutyFd);
+		dutyFd = -1;
+	}
+
+	// Une sortie désactivée (ou un canal libéré) retombe à l'état bas, ce qui
+	// allumerait tout le panneau sur OE (active à l'état bas). Le canal reste
+	// donc actif et exporté, à l'état haut pendant toute la période : un
+	// init() suivant le reprend tel quel
+	exported = false;
+	return writeAttribute(channelPath + "/duty_cycle", to_string(periodNs));
+}
+
+bool CPWM::setDuty(uint32_t dutyNs)
+{
+	// Le retour à la ligne termine la valeur : sysfs l'ignore, et un fichier
+	// ordinaire (arborescence factice) reste lisible malgré l'écriture à la position 0
+	char text[16];
+	int len = snprintf(text, sizeof(text), "%u\n", dutyNs);
+	if (::pwrite(dutyFd, text, len, 0) != len) {
+		error = "OPERATION FAILED: Unable to set PWM duty cycle : " + string(strerror(errno)) + "\n";
+		return false;
+	}
+	return true;
+}
+
+uint32_t CPWM::getPeriod() const
+{
+	return periodNs;
+}
+
+string CPWM::getLastError()
+{
+	string temp = this->error;
+	this->error = "No error \n";
+	return temp;
+}
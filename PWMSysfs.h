@@ -0,0 +1,98 @@
+/**
+\file PWMSysfs.h
+Déclaration de la classe CPWM
+\class CPWM
+\brief Pilotage d'une sortie MLI (PWM) matérielle par le sous-système PWM du noyau (/sys/class/pwm)
+
+Utilisée sur la broche OE d'un panneau, une sortie MLI matérielle fait varier la luminosité
+sans aucune charge processeur ni scintillement : un changement de luminosité se résume à une
+seule écriture dans le fichier 'duty_cycle', gardé ouvert.
+
+L'initialisation suit la séquence imposée par le noyau : exportation du canal si nécessaire,
+mise à zéro du rapport cyclique (une période plus courte que le rapport cyclique courant serait
+refusée), réglage de la période, rapport cyclique égal à la période (état haut permanent, soit
+un panneau éteint sur OE active à l'état bas) puis activation. Le répertoire racine est paramétrable pour
+pouvoir utiliser une arborescence factice.
+
+Comme pour la classe CGPIO, les méthodes renvoient un booléen, le message d'erreur est obtenu
+par getLastError().
+*/
+
+#ifndef PWM_SYSFS_H
+#define PWM_SYSFS_H
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+class CPWM
+{
+public:
+	/**
+	* \brief Constructeur de la classe CPWM
+	* \param[in] chip Numéro de la puce PWM (pwmchipN)
+	* \param[in] channel Numéro du canal sur la puce (pwmM)
+	* \param[in] periodNs Période de la MLI en nanosecondes (par défaut 100 µs, soit 10 kHz)
+	* \param[in] root Répertoire racine du sous-système PWM (par défaut /sys/class/pwm)
+	*/
+	CPWM(int chip, int channel, uint32_t periodNs = 100000, const string& root = "/sys/class/pwm");
+	~CPWM();
+
+	/**
+	* \brief Indique si la puce existe et possède le canal demandé
+	* \return true si le canal est disponible
+	*/
+	bool exists();
+
+	/**
+	* \brief Exporte le canal, règle la période et active la sortie à l'état haut (rapport cyclique égal à la période)
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool init();
+
+	/**
+	* \brief Ferme le canal en le laissant actif à l'état haut permanent : une sortie désactivée
+	* retomberait à l'état bas et allumerait le panneau (OE active à l'état bas)
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	bool close();
+
+	/**
+	* \brief Fixe la durée de l'état haut, en une seule écriture. Aucune vérification n'est faite.
+	* \param[in] dutyNs Durée de l'état haut en nanosecondes (0 à getPeriod())
+	* \return booléen qui indique si l'écriture a échoué (false) ou réussi (true)
+	*/
+	bool setDuty(uint32_t dutyNs);
+
+	/**
+	* \brief Renvoie la période de la MLI en nanosecondes
+	*/
+	uint32_t getPeriod() const;
+
+	/**
+	* \brief Renvoie le dernier message d'erreur puis le réinitialise
+	* \return une chaine de caractère (string) qui contient le message d'erreur
+	*/
+	string getLastError();
+
+private:
+	/// Numéro de la puce et du canal
+	int chip, channel;
+	/// Période de la MLI en nanosecondes
+	uint32_t periodNs;
+	/// Chemins de la puce (root/pwmchipN) et du canal (root/pwmchipN/pwmM)
+	string chipPath, channelPath;
+	/// Descripteur du fichier duty_cycle, -1 tant que le canal n'est pas initialisé
+	int dutyFd;
+	/// Vrai si le canal a été exporté par init()
+	bool exported;
+	/// cette chaine contient le dernier message d'erreur
+	string error;
+
+	bool writeAttribute(const string& path, const string& text);
+	/// Libère le canal s'il a été exporté par init() (échec de l'initialisation)
+	void unexportChannel();
+};
+
+#endif
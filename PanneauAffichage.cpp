@@ -7,34 +7,80 @@
 #include <iostream>
 #include <exception>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
 #include "PanneauAffichage.h"
+#include "Instrumentation.h"
 
-const vector<int> PanneauAffichage::numberDPDown= {119, 65, 59, 107, 77, 110, 126, 67, 127, 111};
-const vector<int> PanneauAffichage::numberDPUp= {119, 20, 59, 62, 92, 110, 111, 52, 127, 126};
-
-PanneauAffichage::PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk) {
+PanneauAffichage::PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk,
+                                   CGPIOBackend* backend) : trame(nbAfficheurs) {
     this->nbAfficheurs = nbAfficheurs;
+    this->backend = (backend != nullptr) ? backend : CGPIO::getDefaultBackend();
+    this->transport = nullptr;
+    this->balayage = nullptr;
+    this->pwm = nullptr;
+    this->pwmMateriel = false;
     this->isInitialized = false;
-    this->oe = nullptr;
-    this->le = nullptr;
-    this->data = nullptr;
-    this->clk = nullptr;
+    this->horlogeActive = false;
+    this->animationActive = false;
+    this->animation = nullptr;
+    this->demandePosition = -1;
+    this->statistiquesLecture = StatistiquesLecture();
     this->pinOE = pinOE;
     this->pinLE = pinLE;
     this->pinData = pinData;
     this->pinClk = pinClk;
+    this->pinsData.assign(1, pinData);
+    setOrientation(Orientation::DPBas);
+}
+
+PanneauAffichage::PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, const vector<int>& pinsData, int pinClk,
+                                   CGPIOBackend* backend)
+    : PanneauAffichage(nbAfficheurs, pinOE, pinLE, pinsData.empty() ? -1 : pinsData[0], pinClk, backend) {
+    if (!pinsData.empty())
+        this->pinsData = pinsData;
+}
+
+PanneauAffichage::PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, CShiftTransport* transport,
+                                   CGPIOBackend* backend)
+    : PanneauAffichage(nbAfficheurs, pinOE, pinLE, -1, -1, backend) {
+    this->transport = transport;
 }
 
 PanneauAffichage::~PanneauAffichage() {
-    // On peut appeler un delete sur un pointeur nul, dans ce cas
-    // le delete ne fait rien
-    delete this->oe;
-    delete this->le;
-    delete this->data;
-    delete this->clk;
+    // Broches libérées même si close() n'a pas été appelée (sans rien
+    // faire si init() n'a jamais réussi). Un destructeur ne doit pas lever
+    // d'exception : les erreurs de fermeture sont ignorées
+    try {
+        close();
+    }
+    catch (Erreur& e) {
+    }
+}
+
+void PanneauAffichage::setOrientation(Orientation orientation) {
+    if (orientation == Orientation::DPBas) {
+        this->police = Police7Segments<Orientation::DPBas>::table.data();
+        this->pointDecimal = Police7Segments<Orientation::DPBas>::pointDecimal;
+    }
+    else {
+        this->police = Police7Segments<Orientation::DPHaut>::table.data();
+        this->pointDecimal = Police7Segments<Orientation::DPHaut>::pointDecimal;
+    }
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    this->trame.invalidate();
 }
 
-void PanneauAffichage::init() throw (PanneauAffichage::Erreur) {
+void PanneauAffichage::setHardwarePWM(CPWM* pwm) {
+    this->pwm = pwm;
+}
+
+bool PanneauAffichage::isHardwarePWM() const {
+    return this->pwmMateriel;
+}
+
+void PanneauAffichage::init() {
     if (this->isInitialized)
         return;
     
@@ -43,118 +89,301 @@ void PanneauAffichage::init() throw (PanneauAffichage::Erreur) {
         return;
     }
     
-    if (this->pinOE<0 || this->pinLE<0 || this->pinData<0 || this->pinClk<0) {
+    // Avec un transport, DATA et CLK ne sont pas pilotées par le panneau
+    vector<int> pins = {this->pinOE, this->pinLE};
+    if (this->transport == nullptr) {
+        if (this->pinsData.size() > CGPIOPort::maxPins - 2) {
+            throw (Erreur("Trop de lignes DATA"));
+            return;
+        }
+        pins.push_back(this->pinClk);
+        pins.insert(pins.end(), this->pinsData.begin(), this->pinsData.end());
+    }
+    
+    if (*std::min_element(pins.begin(), pins.end()) < 0) {
         throw (Erreur("Une broche ne peut avoir une valeur negative"));
         return;
     }
     
-    if (this->pinOE == this->pinLE || this->pinOE == this->pinData || this->pinOE == this->pinClk ||
-        this->pinLE == this->pinData || this->pinLE == this->pinClk || this->pinData == this->pinClk) {
+    std::sort(pins.begin(), pins.end());
+    if (std::adjacent_find(pins.begin(), pins.end()) != pins.end()) {
         throw (Erreur("Les numeros de broche doivent être tous différents"));
         return;
     }
     
-    this->oe   = new CGPIO(this->pinOE, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::HIGH);
-    this->le   = new CGPIO(this->pinLE, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::LOW);
-    this->data = new CGPIO(this->pinData, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::LOW);
-    this->clk  = new CGPIO(this->pinClk, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::LOW);
+    // Les objets ne sont confiés au panneau qu'une fois tout initialisé : en
+    // cas d'échec, ceux déjà créés sont libérés et init() peut être rappelée
+    // Avec une sortie MLI matérielle disponible, OE n'est pas une broche GPIO
+    this->pwmMateriel = (this->pwm != nullptr && this->pwm->init());
+    if (this->pwm != nullptr && !this->pwmMateriel)
+        cerr << "PanneauAffichage : MLI matérielle indisponible, OE pilotée en MLI logicielle : "
+             << this->pwm->getLastError();
     
-    if (!this->oe->init()) {
-        throw (Erreur(this->oe->getLastError()));
-        return;
-    }
+    // La sortie MLI est libérée à la sortie de init() si une étape suivante échoue
+    struct LiberationMLI {
+        PanneauAffichage* panneau;
+        bool valide = false;
+        ~LiberationMLI() {
+            if (!this->valide && this->panneau->pwmMateriel) {
+                this->panneau->pwm->close();
+                this->panneau->pwmMateriel = false;
+            }
+        }
+    } liberationMLI{this};
     
-    if (!this->le->init()) {
-        throw (Erreur(this->le->getLastError()));
-        return;
+    std::unique_ptr<CGPIO> oe;
+    if (!this->pwmMateriel) {
+        oe.reset(new CGPIO(this->pinOE, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::HIGH, this->backend));
+        if (!oe->init()) {
+            throw (Erreur(oe->getLastError()));
+            return;
+        }
     }
     
-    if (!this->data->init()) {
-        throw (Erreur(this->data->getLastError()));
+    // LE, DATA et CLK sont réservées ensemble et modifiées par une seule
+    // opération à chaque étape de la séquence. Avec plusieurs lignes DATA,
+    // elles suivent CLK dans le port
+    vector<int> portPins = {this->pinLE};
+    if (this->transport == nullptr) {
+        if (this->pinsData.size() == 1)
+            portPins.insert(portPins.end(), {this->pinData, this->pinClk});
+        else {
+            portPins.push_back(this->pinClk);
+            portPins.insert(portPins.end(), this->pinsData.begin(), this->pinsData.end());
+        }
+    }
+    std::unique_ptr<CGPIOPort> port(new CGPIOPort(portPins.data(), portPins.size(), this->backend));
+    if (!port->init()) {
+        string erreur = port->getLastError();
+        if (oe)
+            oe->close();
+        throw (Erreur(erreur));
         return;
     }
     
-    if (!this->clk->init()) {
-        throw (Erreur(this->clk->getLastError()));
+    if (this->transport != nullptr && !this->transport->init()) {
+        string erreur = this->transport->getLastError();
+        this->transport->close();
+        port->close();
+        if (oe)
+            oe->close();
+        throw (Erreur(erreur));
         return;
     }
     
+    // Le moteur de luminosité pilote désormais OE (sorties désactivées au départ)
+    this->oe = std::move(oe);
+    this->port = std::move(port);
+    this->luminosite.reset(new MoteurLuminosite(this->oe.get(), this->pwmMateriel ? this->pwm : nullptr));
+    this->luminosite->start();
+    liberationMLI.valide = true;
+    
+    // L'état des registres à décalage est inconnu : le premier envoi sera complet
+    this->trame.invalidate();
     this->isInitialized = true;
 }
 
-void PanneauAffichage::close() throw(PanneauAffichage::Erreur) {
-    /*
-    if (!this->isInitialized) {
-        throw (Erreur("Le panneau ne peut être fermé car il n\'a pas été initialisé"));
+void PanneauAffichage::close() {
+    // Sans effet si le panneau n'est pas initialisé (ou déjà fermé). Le
+    // moteur de luminosité utilise OE : il est arrêté en premier, après le
+    // mode horloge et les animations qui envoient des trames et le
+    // balayage qui utilise le port
+    if (!this->isInitialized)
         return;
-    }
-    */
-    if (!this->oe->close()) {
-        throw (Erreur(this->oe->getLastError()));
-        return;    
-    }
-    
-    if (!this->le->close()) {
-        throw (Erreur(this->le->getLastError()));
-        return;    
-    }
+    stopAnimation();
+    stopClock();
+    stopScan();
+    this->luminosite.reset();
+    this->isInitialized = false;
+    // Après une réouverture, l'état des registres à décalage est inconnu
+    this->trame.invalidate();
     
-    if (!this->data->close()) {
-        throw (Erreur(this->data->getLastError()));
-        return;    
-    }
+    // Toutes les broches et le transport sont libérés, même si l'un d'eux échoue : la
+    // première erreur est signalée ensuite
+    string erreur;
+    if (this->pwmMateriel && !this->pwm->close())
+        erreur = this->pwm->getLastError();
+    this->pwmMateriel = false;
+    if (this->oe && !this->oe->close() && erreur.empty())
+        erreur = this->oe->getLastError();
+    if (!this->port->close() && erreur.empty())
+        erreur = this->port->getLastError();
+    if (this->transport != nullptr && !this->transport->close() && erreur.empty())
+        erreur = this->transport->getLastError();
+    this->oe.reset();
+    this->port.reset();
     
-    if (!this->clk->close()) {
-        throw (Erreur(this->clk->getLastError()));
-        return;    
+    if (!erreur.empty()) {
+        throw (Erreur(erreur));
+        return;
     }
 }
 
-void PanneauAffichage::displayNumber(string number) throw(PanneauAffichage::Erreur) {
-    if (number.size() > this->nbAfficheurs) {
+void PanneauAffichage::displayNumber(const string& number) {
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    fillDigits(number.data(), number.size(), false, FormatNombre(), this->trame.bytes());
+    pushFrame();
+}
+
+void PanneauAffichage::displayNumberWithLeadingZero(const string& number) {
+    // Si le nombre a affiché est plus petit que le nb d'fficheurs
+    // on rajoute des zeros devant
+    FormatNombre format;
+    format.zeros = true;
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    fillDigits(number.data(), number.size(), false, format, this->trame.bytes());
+    pushFrame();
+}
+
+// Caractères des nombres de 00 à 99 : deux chiffres par division au lieu d'un
+static constexpr std::array<char, 200> paires = []() {
+    std::array<char, 200> t{};
+    for (int i = 0; i < 100; i++) {
+        t[2 * i] = '0' + i / 10;
+        t[2 * i + 1] = '0' + i % 10;
+    }
+    return t;
+}();
+
+static constexpr double puissances[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                        1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+static constexpr int decimalesMax = 18;
+
+void PanneauAffichage::displayNumber(double value, const FormatNombre& format) {
+    if (!std::isfinite(value))
+        throw (Erreur("Le nombre a affiché doit être fini"));
+    if (format.decimales < 0 || format.decimales > decimalesMax)
+        throw (Erreur("Nombre de décimales invalide"));
+    
+    double arrondi = std::round(std::fabs(value) * puissances[format.decimales]);
+    if (arrondi >= 18446744073709551616.0)
         throw (Erreur("Nombre trop grand pour être affiché"));
+    uint64_t magnitude = (uint64_t)arrondi;
+    // Pas de "-0" pour une valeur négative arrondie à zéro
+    displayInteger(magnitude, value < 0 && magnitude != 0, format);
+}
+
+void PanneauAffichage::displayInteger(uint64_t magnitude, bool negative, const FormatNombre& format) {
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    encodeInteger(magnitude, negative, format, this->trame.bytes());
+    pushFrame();
+}
+
+void PanneauAffichage::encodeInteger(uint64_t magnitude, bool negative, const FormatNombre& format,
+                                     uint8_t* octets) const {
+    if (format.eteindreSiZero && magnitude == 0) {
+        std::fill(octets, octets + this->nbAfficheurs, 0);
         return;
     }
     
-    if (number.size() == 0) {
-        throw (Erreur("Le nombre a affiché ne peut être vide"));
-        return;
+    // Conversion de droite à gauche, par paires de chiffres (20 chiffres au
+    // plus pour un entier de 64 bits)
+    char chiffres[20];
+    int pos = sizeof(chiffres);
+    while (magnitude >= 100) {
+        int r = magnitude % 100;
+        magnitude /= 100;
+        pos -= 2;
+        chiffres[pos] = paires[2 * r];
+        chiffres[pos + 1] = paires[2 * r + 1];
+    }
+    if (magnitude >= 10) {
+        pos -= 2;
+        chiffres[pos] = paires[2 * magnitude];
+        chiffres[pos + 1] = paires[2 * magnitude + 1];
     }
+    else
+        chiffres[--pos] = '0' + magnitude;
+    
+    fillDigits(chiffres + pos, sizeof(chiffres) - pos, negative, format, octets);
+}
+
+void PanneauAffichage::fillDigits(const char* chiffres, int n, bool negative, const FormatNombre& format,
+                                  uint8_t* octets) const {
+    if (n == 0)
+        throw (Erreur("Le nombre a affiché ne peut être vide"));
     
-    for (int i=0; i<number.size(); i++) {
-        if (number.at(i) < '0' || number.at(i) > '9') {
+    for (int i=0; i<n; i++) {
+        if (chiffres[i] < '0' || chiffres[i] > '9')
             throw (Erreur("Affichage des chiffres 0 à 9 uniquement"));
-            return;
-        }
     }
     
-    outputDisable();
+    if (format.decimales < 0 || format.decimales > decimalesMax)
+        throw (Erreur("Nombre de décimales invalide"));
     
-    // Si le nombre a affiché est plus petit que le nb d'fficheurs
-    // on "éteint" les afficheurs concernés
-    if (number.size() < this->nbAfficheurs) {
-        for (int i=0; i<(this->nbAfficheurs - number.size()); i++)
-            sendOneByte(0);
-    }
+    // Au moins un chiffre avant la virgule : 5 avec 2 décimales donne 0.05
+    int nbChiffres = std::max(n, format.decimales + 1);
+    if (nbChiffres + (negative ? 1 : 0) > this->nbAfficheurs)
+        throw (Erreur("Nombre trop grand pour être affiché"));
     
-    for (int i=0; i<number.size(); i++) {
-        sendOneByte(numberDPDown.at(number.at(i) - '0'));
-    }
+    uint8_t zero = this->police['0'];
+    uint8_t moins = this->police['-'];
+    int pos = this->nbAfficheurs - 1;
+    for (int i=n-1; i>=0; i--)
+        octets[pos--] = this->police[(uint8_t)chiffres[i]];
+    for (int i=n; i<nbChiffres; i++)
+        octets[pos--] = zero;
+    if (format.decimales > 0)
+        octets[this->nbAfficheurs - 1 - format.decimales] |= this->pointDecimal;
     
-    latchValue();
-    //outputEnable();
+    // Partie gauche : zéros non significatifs ou afficheurs éteints, le
+    // signe étant devant le nombre ou sur le premier afficheur
+    uint8_t remplissage = format.zeros ? zero : 0;
+    if (negative) {
+        if (format.zeros || format.signeAGauche) {
+            octets[0] = moins;
+            for (int i=1; i<=pos; i++)
+                octets[i] = remplissage;
+        }
+        else {
+            octets[pos--] = moins;
+            for (int i=0; i<=pos; i++)
+                octets[i] = remplissage;
+        }
+    }
+    else {
+        for (int i=0; i<=pos; i++)
+            octets[i] = remplissage;
+    }
 }
 
-void PanneauAffichage::displayNumberWithLeadingZero(string number) throw(PanneauAffichage::Erreur) {
-    // Si le nombre a affiché est plus petit que le nb d'fficheurs
-    // on rajoute des zeros devant
-    string temp;
-    if (number.size() < this->nbAfficheurs) {
-        for (int i=0; i<(this->nbAfficheurs - number.size()); i++)
-            temp +="0";
+void PanneauAffichage::displayText(std::string_view text) {
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    encodeText(text, this->trame.bytes());
+    pushFrame();
+}
+
+void PanneauAffichage::encodeText(std::string_view text, uint8_t* octets) const {
+    // encoderTexte() remplit les octets au fil du texte : la conversion est
+    // faite dans un tampon local (sur la pile pour les panneaux courants)
+    // pour que 'octets' ne reçoive jamais une trame à moitié écrite
+    uint8_t local[64];
+    std::unique_ptr<uint8_t[]> alloue;
+    uint8_t* tampon = local;
+    if (this->nbAfficheurs > (int)sizeof(local)) {
+        alloue.reset(new uint8_t[this->nbAfficheurs]);
+        tampon = alloue.get();
+    }
+    char invalide;
+    switch (encoderTexte(text, this->police, this->pointDecimal, tampon, this->nbAfficheurs, invalide)) {
+        case ResultatTexte::CaractereInvalide:
+            throw (Erreur(string("Caractère non affichable : ") + invalide));
+        case ResultatTexte::TropLong:
+            throw (Erreur("Texte trop long pour être affiché"));
+        default:
+            break;
     }
-    number = temp + number;
-    displayNumber(number);
+    std::copy(tampon, tampon + this->nbAfficheurs, octets);
+}
+
+void PanneauAffichage::displayFrame(const uint8_t* octets) {
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    std::copy(octets, octets + this->nbAfficheurs, this->trame.bytes());
+    pushFrame(false);
+}
+
+int PanneauAffichage::getNbAfficheurs() const {
+    return this->nbAfficheurs;
 }
 
 void PanneauAffichage::displayDateTime() {
@@ -190,48 +419,418 @@ void PanneauAffichage::displayDateTime() {
     fadeOut();
 }
 
+Delai PanneauAffichage::show(std::string_view text, std::chrono::milliseconds duree) {
+    displayText(text);
+    return after(duree);
+}
+
+Tache PanneauAffichage::showDateTime() {
+    std::time_t result = std::time(NULL);
+    char mbstr[30];
+    std::strftime(mbstr, sizeof(mbstr), "%d%m%y%H%M%S", std::localtime(&result));
+    string dateheure(mbstr);
+
+    // Jour, mois, année, puis heure et minutes après une pause d'une seconde
+    for (int i=0; i<5; i++) {
+        if (i == 3)
+            co_await after(std::chrono::seconds(1));
+        displayNumber(dateheure.substr(2 * i, 2));
+        co_await fadeTo(MoteurLuminosite::luminositeMax, std::chrono::seconds(1));
+        co_await fadeTo(0, std::chrono::seconds(1));
+    }
+}
+
+void PanneauAffichage::startClock(const OptionsHorloge& options) {
+    if (!this->isInitialized)
+        throw (Erreur("Le panneau doit être initialisé avant le mode horloge"));
+    if (this->nbAfficheurs < 2)
+        throw (Erreur("Le mode horloge nécessite au moins 2 afficheurs"));
+    if (options.dureePage < 1)
+        throw (Erreur("La durée d\'une page doit être d\'au moins une seconde"));
+    
+    stopClock();
+    std::lock_guard<std::mutex> lock(this->mutexHorloge);
+    this->optionsHorloge = options;
+    this->horlogeActive = true;
+    this->threadHorloge = std::thread(&PanneauAffichage::runClock, this);
+}
+
+void PanneauAffichage::stopClock() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutexHorloge);
+        if (!this->horlogeActive)
+            return;
+        this->horlogeActive = false;
+    }
+    this->conditionHorloge.notify_one();
+    this->threadHorloge.join();
+}
+
+void PanneauAffichage::startScan(const OptionsBalayage& options) {
+    if (!this->isInitialized)
+        throw (Erreur("Le panneau doit être initialisé avant le mode balayage"));
+    if (this->pinsData.size() > 1)
+        throw (Erreur("Le mode balayage n\'utilise qu\'une ligne DATA"));
+    
+    stopScan();
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    BalayageAffichage* balayage = new BalayageAffichage(this->port.get(), this->transport, this->nbAfficheurs, options);
+    balayage->setFrame(this->trame.bytes());
+    try {
+        balayage->start();
+    }
+    catch (Erreur& e) {
+        delete balayage;
+        throw;
+    }
+    this->balayage = balayage;
+}
+
+void PanneauAffichage::stopScan() {
+    // Le verrou est gardé jusqu'à l'arrêt du thread : aucune trame n'est
+    // envoyée sur le port pendant qu'il l'utilise encore
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    if (this->balayage == nullptr)
+        return;
+    delete this->balayage;
+    this->balayage = nullptr;
+    // Les registres contiennent le dernier créneau : le prochain envoi sera complet
+    this->trame.invalidate();
+}
+
+StatistiquesBalayage PanneauAffichage::getScanStats() const {
+    if (this->balayage == nullptr)
+        return StatistiquesBalayage();
+    return this->balayage->getStats();
+}
+
+void PanneauAffichage::play(const AnimationAffichage& animation, const OptionsLecture& options) {
+    if (!this->isInitialized)
+        throw (Erreur("Le panneau doit être initialisé avant la lecture d\'une animation"));
+    if (animation.size() == 0 || animation.getNbAfficheurs() != this->nbAfficheurs)
+        throw (Erreur("L\'animation ne correspond pas au nombre d\'afficheurs du panneau"));
+    
+    stopAnimation();
+    stopClock();
+    std::lock_guard<std::mutex> lock(this->mutexAnimation);
+    this->animation = &animation;
+    this->optionsLecture = options;
+    this->demandePosition = -1;
+    this->statistiquesLecture = StatistiquesLecture();
+    this->animationActive = true;
+    this->threadAnimation = std::thread(&PanneauAffichage::runAnimation, this);
+}
+
+void PanneauAffichage::seek(std::chrono::milliseconds position) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutexAnimation);
+        if (!this->animationActive)
+            return;
+        this->demandePosition = std::max(position.count(), (int64_t)0);
+    }
+    this->conditionAnimation.notify_one();
+}
+
+void PanneauAffichage::stopAnimation() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutexAnimation);
+        this->animationActive = false;
+    }
+    this->conditionAnimation.notify_one();
+    // Le thread peut aussi s'être arrêté seul à la fin de l'animation
+    if (this->threadAnimation.joinable())
+        this->threadAnimation.join();
+}
+
+bool PanneauAffichage::isPlaying() {
+    std::lock_guard<std::mutex> lock(this->mutexAnimation);
+    return this->animationActive;
+}
+
+StatistiquesLecture PanneauAffichage::getPlaybackStats() {
+    std::lock_guard<std::mutex> lock(this->mutexAnimation);
+    return this->statistiquesLecture;
+}
+
+void PanneauAffichage::runAnimation() {
+    typedef std::chrono::steady_clock horloge;
+    const AnimationAffichage& a = *this->animation;
+    size_t n = a.size();
+    size_t i = 0;
+    // Après un démarrage, un positionnement ou une reprise en boucle, la
+    // trame et la luminosité de l'étape sont appliquées même si elles ne
+    // changent pas dans l'animation
+    bool complete = true;
+    horloge::time_point origine = horloge::now();
+    a.precharger(0, 128);
+    
+    std::unique_lock<std::mutex> lock(this->mutexAnimation);
+    while (this->animationActive) {
+        if (this->demandePosition >= 0) {
+            i = a.chercher(this->demandePosition);
+            origine = horloge::now() - std::chrono::milliseconds(this->demandePosition);
+            this->demandePosition = -1;
+            complete = true;
+            a.precharger(i, 128);
+        }
+        if (i >= n) {
+            uint64_t debut = a.etape(a.getReprise()).instant;
+            if (!this->optionsLecture.boucle || a.getDuree() <= debut) {
+                this->animationActive = false;
+                break;
+            }
+            origine += std::chrono::milliseconds(a.getDuree() - debut);
+            i = a.getReprise();
+            complete = true;
+            a.precharger(i, 128);
+        }
+        
+        // Echéance absolue : le temps passé à envoyer une étape ne décale
+        // pas les suivantes
+        horloge::time_point echeance = origine + std::chrono::milliseconds(a.etape(i).instant);
+        if (this->conditionAnimation.wait_until(lock, echeance, [this] {
+                return !this->animationActive || this->demandePosition >= 0; }))
+            continue;
+        
+        uint8_t changements = a.etape(i).changements;
+        horloge::time_point maintenant = horloge::now();
+        while (i + 1 < n && origine + std::chrono::milliseconds(a.etape(i + 1).instant) <= maintenant) {
+            i++;
+            changements |= a.etape(i).changements;
+            this->statistiquesLecture.etapesSautees++;
+        }
+        if (complete)
+            changements = EtapeAnimation::TrameModifiee | EtapeAnimation::LuminositeModifiee;
+        
+        lock.unlock();
+        try {
+            playStep(a, i, changements);
+        }
+        catch (Erreur& e) {
+            cerr << e.what() << endl;
+        }
+        lock.lock();
+        
+        this->statistiquesLecture.etapes++;
+        if (i % 64 == 0)
+            a.precharger(i + 64, 128);
+        complete = false;
+        i++;
+    }
+}
+
+void PanneauAffichage::playStep(const AnimationAffichage& animation, size_t i, uint8_t changements) {
+    const EtapeAnimation& etape = animation.etape(i);
+    if (changements & EtapeAnimation::TrameModifiee) {
+        std::lock_guard<std::mutex> lock(this->mutexTrame);
+        if (this->balayage != nullptr)
+            this->balayage->setFrame(animation.trame(i));
+        else {
+            Instrumentation::countOperation(Instrumentation::Operation::Trame);
+            sendFrame(animation.trame(i), false);
+            // Les registres ne contiennent plus la trame du panneau
+            this->trame.invalidate();
+        }
+    }
+    // Luminosité appliquée sans son fondu quand l'étape ne la modifie pas
+    // elle-même (démarrage, positionnement)
+    if ((changements & EtapeAnimation::LuminositeModifiee) && etape.luminosite != EtapeAnimation::luminositeLibre) {
+        if (etape.changements & EtapeAnimation::LuminositeModifiee)
+            luminosite->fadeTo(etape.luminosite, std::chrono::milliseconds(etape.fondu));
+        else
+            luminosite->setBrightness(etape.luminosite);
+    }
+}
+
+void PanneauAffichage::runClock() {
+    // Heure locale décomposée mise en cache : localtime_r() n'est appelée
+    // qu'au changement de minute (ou si l'horloge système est modifiée)
+    struct tm tm;
+    time_t debutMinute = 0;
+    bool cacheValide = false;
+    
+    const OptionsHorloge& options = this->optionsHorloge;
+    int champsParPage = this->nbAfficheurs / 2;
+    bool chaqueSeconde = options.clignotement ||
+                         options.disposition != DispositionHorloge::HeuresMinutes ||
+                         champsParPage < 2;
+    
+    std::unique_lock<std::mutex> lock(this->mutexHorloge);
+    while (this->horlogeActive) {
+        struct timespec maintenant;
+        clock_gettime(CLOCK_REALTIME, &maintenant);
+        time_t t = maintenant.tv_sec;
+        if (!cacheValide || t < debutMinute || t - debutMinute >= 60) {
+            localtime_r(&t, &tm);
+            debutMinute = t - tm.tm_sec;
+            cacheValide = true;
+        }
+        else
+            tm.tm_sec = t - debutMinute;
+        
+        lock.unlock();
+        try {
+            renderClock(tm, t);
+        }
+        catch (Erreur& e) {
+            cerr << e.what() << endl;
+        }
+        lock.lock();
+        
+        // Echéance absolue sur l'horloge temps réel : pas de dérive, et un
+        // réglage de l'heure système est pris en compte au réveil suivant
+        time_t prochain = chaqueSeconde ? t + 1 : debutMinute + 60;
+        this->conditionHorloge.wait_until(lock, std::chrono::system_clock::from_time_t(prochain),
+                                          [this] { return !this->horlogeActive; });
+    }
+}
+
+void PanneauAffichage::renderClock(const struct tm& tm, time_t t) {
+    const OptionsHorloge& options = this->optionsHorloge;
+    int heure[] = {tm.tm_hour, tm.tm_min, tm.tm_sec};
+    int date[] = {tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100};
+    int nbHeure = (options.disposition == DispositionHorloge::HeuresMinutesSecondes) ? 3 : 2;
+    
+    // Pages de champs de 2 chiffres : autant de champs que le panneau en
+    // contient, les pages de l'heure puis celles de la date en rotation
+    int champsParPage = this->nbAfficheurs / 2;
+    int pagesHeure = (nbHeure + champsParPage - 1) / champsParPage;
+    int pagesDate = (options.disposition == DispositionHorloge::RotationDate) ? (3 + champsParPage - 1) / champsParPage : 0;
+    int page = (t / options.dureePage) % (pagesHeure + pagesDate);
+    
+    const int* champs;
+    int nb;
+    bool separateur;
+    if (page < pagesHeure) {
+        champs = heure + page * champsParPage;
+        nb = std::min(champsParPage, nbHeure - page * champsParPage);
+        separateur = !options.clignotement || (tm.tm_sec % 2 == 0);
+    }
+    else {
+        page -= pagesHeure;
+        champs = date + page * champsParPage;
+        nb = std::min(champsParPage, 3 - page * champsParPage);
+        separateur = true;
+    }
+    
+    std::lock_guard<std::mutex> lock(this->mutexTrame);
+    uint8_t* octets = this->trame.bytes();
+    int debut = this->nbAfficheurs - 2 * nb;
+    for (int i=0; i<debut; i++)
+        octets[i] = 0;
+    for (int i=0; i<nb; i++) {
+        octets[debut + 2 * i] = this->police['0' + champs[i] / 10];
+        octets[debut + 2 * i + 1] = this->police['0' + champs[i] % 10];
+        if (separateur && i < nb - 1)
+            octets[debut + 2 * i + 1] |= this->pointDecimal;
+    }
+    pushFrame(false);
+}
+
 void PanneauAffichage::fadeIn() {
-        for (int j=0; j<100; j++) {
-                oe->fixLow();
-		usleep(100*j);
-		oe->fixHigh();
-		usleep(10000-100*j);	
-	}
-	oe->fixLow();
+    fadeTo(MoteurLuminosite::luminositeMax, std::chrono::seconds(1)).wait();
 }
 
 void PanneauAffichage::fadeOut() {
-        for (int j=0; j<100; j++) {
-                oe->fixHigh();
-                usleep(100*j);
-                oe->fixLow();
-                usleep(10000-100*j);
-	}
-	oe->fixHigh();
-}
-
-void PanneauAffichage::sendOneByte(int value) {
-    value = value & 0xFF;
-    for (int i=0; i<8; i++) {
-        if ((value&0x01) == 1)
-            data->fixHigh();
-        else
-            data->fixLow();
-        clk->fixHigh();
-	clk->fixLow();
-        value = value >> 1;
+    fadeTo(0, std::chrono::seconds(1)).wait();
+}
+
+void PanneauAffichage::setBrightness(int level) {
+    if (!this->luminosite)
+        throw (Erreur("Le panneau doit être initialisé avant de régler la luminosité"));
+    luminosite->setBrightness(level);
+}
+
+AttenteFondu PanneauAffichage::fadeTo(int level, std::chrono::milliseconds duration,
+                                      std::function<void()> onDone) {
+    if (!this->luminosite)
+        throw (Erreur("Le panneau doit être initialisé avant de régler la luminosité"));
+    // La fin du fondu reprend aussi la coroutine qui l'attend éventuellement
+    auto evenement = std::make_shared<EvenementAffichage>();
+    std::future<void> f = luminosite->fadeTo(level, duration, [evenement, onDone]() {
+        if (onDone)
+            onDone();
+        evenement->signal();
+    });
+    return AttenteFondu(std::move(f), evenement);
+}
+
+void PanneauAffichage::pushFrame(bool disable) {
+    // Vérifié avant le raccourci de la trame verrouillée, qui utilise OE
+    if (!this->isInitialized)
+        throw (Erreur("Le panneau doit être initialisé avant l\'affichage"));
+    
+    // Mode balayage : le thread de balayage prend la trame au cycle suivant
+    if (this->balayage != nullptr) {
+        this->balayage->setFrame(this->trame.bytes());
+        return;
+    }
+    
+    // Trame identique à celle déjà verrouillée : inutile de la renvoyer,
+    // les sorties sont seulement désactivées comme lors d'un envoi
+    if (this->trame.isLatched()) {
+        Instrumentation::countOperation(Instrumentation::Operation::TrameEvitee);
+        if (disable)
+            outputDisable();
+        return;
+    }
+    Instrumentation::countOperation(Instrumentation::Operation::Trame);
+    sendFrame(this->trame.bytes(), disable);
+    this->trame.latch();
+}
+
+void PanneauAffichage::sendFrame(const uint8_t* octets, bool disable) {
+    if (!this->isInitialized)
+        throw (Erreur("Le panneau doit être initialisé avant l\'affichage"));
+    
+    // Décalage confié au transport : une seule opération pour toute la chaine
+    if (this->transport != nullptr) {
+        if (disable)
+            outputDisable();
+        bool envoye;
+        {
+            Instrumentation::Chrono chrono(Instrumentation::Latence::Decalage);
+            envoye = this->transport->send(octets, this->nbAfficheurs);
+        }
+        if (!envoye) {
+            Instrumentation::countError(Instrumentation::Erreur::Transport);
+            throw (Erreur(this->transport->getLastError()));
+        }
+        {
+            Instrumentation::Chrono chrono(Instrumentation::Latence::Verrouillage);
+            latchValue();
+        }
+        return;
+    }
+    
+    // OE appartient au moteur de luminosité : la séquence ne la modifie pas.
+    // L'impulsion sur LE fait partie de la séquence, sa durée est comptée
+    // avec le décalage
+    static const TrameAffichage::Broches broches = {0x0, 0x1, 0x2, 0x4};
+    if (disable)
+        outputDisable();
+    this->steps.clear();
+    if (this->pinsData.size() > 1) {
+        TrameAffichage::BrochesParalleles paralleles = {0x1, 0x2, 2, (int)this->pinsData.size()};
+        TrameAffichage::appendSlices(this->steps, octets, this->nbAfficheurs, paralleles);
+    }
+    else
+        TrameAffichage::append(this->steps, octets, this->nbAfficheurs, broches);
+    {
+        Instrumentation::Chrono chrono(Instrumentation::Latence::Decalage);
+        this->port->writeSequence(this->steps.data(), this->steps.size());
     }
 }
 
 void PanneauAffichage::latchValue() {
-    le->fixHigh();
-    le->fixLow();
+    this->port->write(0x1, 0);
+    this->port->write(0, 0x1);
 }
 
 void PanneauAffichage::outputEnable() {
-    oe->fixLow();
+    luminosite->setBrightness(MoteurLuminosite::luminositeMax);
 }
 
 void PanneauAffichage::outputDisable() {
-    oe->fixHigh();
+    luminosite->setBrightness(0);
 }
\ No newline at end of file
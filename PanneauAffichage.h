@@ -10,15 +10,84 @@
 
 #include <cstdint>
 #include <exception>
+#include <memory>
 #include <vector>
+#include <string_view>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
 #include "GPIOClass.h"
+#include "GPIOPort.h"
+#include "TrameAffichage.h"
+#include "ShiftTransport.h"
+#include "MoteurLuminosite.h"
+#include "BalayageAffichage.h"
+#include "OrdonnanceurAffichage.h"
+#include "AnimationAffichage.h"
+#include "Police7Segments.h"
+
+// Options d'affichage d'un nombre (voir PanneauAffichage::displayNumber)
+struct FormatNombre {
+    // Zéros non significatifs à gauche plutôt qu'afficheurs éteints
+    bool zeros = false;
+    // Nombre de chiffres après la virgule (point décimal), 0 pour un entier.
+    // Pour un entier, la valeur est lue en virgule fixe : 1234 avec 2
+    // décimales s'affiche 12.34
+    int decimales = 0;
+    // Signe '-' sur l'afficheur le plus à gauche plutôt que devant le nombre
+    bool signeAGauche = false;
+    // Eteint tout le panneau quand la valeur est nulle
+    bool eteindreSiZero = false;
+};
+
+// Dispositions du mode horloge (voir PanneauAffichage::startClock)
+enum class DispositionHorloge {
+    HeuresMinutes,              // HH.MM
+    HeuresMinutesSecondes,      // HH.MM.SS
+    RotationDate                // HH.MM en alternance avec JJ.MM.AA
+};
+
+struct OptionsHorloge {
+    DispositionHorloge disposition = DispositionHorloge::HeuresMinutes;
+    // Séparateur des heures (point décimal) allumé une seconde sur deux
+    bool clignotement = false;
+    // Durée d'affichage d'une page en secondes, quand tout ne tient pas sur
+    // le panneau (2 chiffres par champ) ou en rotation heure/date
+    int dureePage = 5;
+};
+
+// Lecture d'une animation précompilée (voir PanneauAffichage::play)
+struct OptionsLecture {
+    // Reprise au point 'boucle' de l'animation (ou au début) à la fin
+    bool boucle = false;
+};
+
+struct StatistiquesLecture {
+    uint64_t etapes;            // étapes jouées
+    uint64_t etapesSautees;     // étapes dépassées sans être jouées (retard)
+};
 
 class PanneauAffichage {
 public:
-    static const vector<int> numberDPDown; //= {119, 65, 59, 107, 77, 110, 126, 67, 127, 111};
-    static const vector<int> numberDPUp;   //= {119, 20, 59, 62, 92, 110, 111, 52, 127, 126};
+    static constexpr std::array<int, 10> numberDPDown = Police7Segments<Orientation::DPBas>::chiffres;  //= {119, 65, 59, 107, 77, 110, 126, 67, 127, 111}
+    static constexpr std::array<int, 10> numberDPUp = Police7Segments<Orientation::DPHaut>::chiffres;   //= {119, 20, 59, 62, 92, 110, 111, 52, 127, 126}
     
-    PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk);
+    // backend : méthode d'accés aux broches (sysfs par défaut), par exemple un
+    // CGPIOMmapBackend pour envoyer les octets à la vitesse des registres
+    PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, int pinData, int pinClk,
+                     CGPIOBackend* backend = nullptr);
+    // Variante à plusieurs lignes DATA (30 au plus), chacune reliée à sa
+    // propre sous-chaine de registres et toutes cadencées par CLK : une
+    // trame est envoyée pinsData.size() fois plus vite (voir
+    // TrameAffichage::appendSlices pour la répartition des afficheurs)
+    PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, const vector<int>& pinsData, int pinClk,
+                     CGPIOBackend* backend = nullptr);
+    // Variante où le décalage des octets est confié à un transport (SPI matériel...),
+    // seules les broches OE et LE sont alors pilotées par le panneau
+    PanneauAffichage(int nbAfficheurs, int pinOE, int pinLE, CShiftTransport* transport,
+                     CGPIOBackend* backend = nullptr);
     virtual ~PanneauAffichage();
     
     class Erreur : exception {
@@ -37,27 +106,179 @@ public:
         string message;
     };
     
-    void init() throw(Erreur);
-    void close() throw(Erreur);
+    // Sortie MLI matérielle reliée à OE, à fournir avant init(). Si le canal
+    // ne peut être initialisé, init() le signale sur cerr et OE est pilotée
+    // comme une broche ordinaire (MLI logicielle), voir isHardwarePWM()
+    void setHardwarePWM(CPWM* pwm);
+    // Vrai si la luminosité passe par la sortie MLI matérielle
+    bool isHardwarePWM() const;
+    
+    // Câblage des afficheurs (DPBas par défaut)
+    void setOrientation(Orientation orientation);
+    
+    // Les méthodes suivantes lèvent une exception PanneauAffichage::Erreur
+    // en cas de problème
+    void init();
+    void close();
+    // Fondus bloquants d'une seconde (compatibilité), voir fadeTo()
     void fadeIn();
     void fadeOut();
-    void displayNumber(string number) throw(Erreur);
-    void displayNumberWithLeadingZero(string number) throw(Erreur);
+    // Luminosité de 0 (éteint) à MoteurLuminosite::luminositeMax, sans attente :
+    // le fondu est réalisé par le thread du moteur de luminosité. Dans une
+    // Tache, co_await panneau.fadeTo(...) attend la fin du fondu sans
+    // bloquer l'ordonnanceur
+    void setBrightness(int level);
+    AttenteFondu fadeTo(int level, std::chrono::milliseconds duration,
+                        std::function<void()> onDone = nullptr);
+    void displayNumber(const string& number);
+    void displayNumberWithLeadingZero(const string& number);
+    // Affichage d'un entier (ou d'une valeur en virgule fixe) directement dans
+    // la trame, sans passer par une chaine ni allouer de mémoire
+    template<typename T, typename std::enable_if<std::is_integral<T>::value &&
+                                                 !std::is_same<T, bool>::value &&
+                                                 !std::is_same<T, char>::value, int>::type = 0>
+    void displayNumber(T value, const FormatNombre& format = FormatNombre()) {
+        uint64_t magnitude;
+        bool negative;
+        split(value, magnitude, negative);
+        displayInteger(magnitude, negative, format);
+    }
+    // Valeur arrondie à format.decimales chiffres après la virgule
+    void displayNumber(double value, const FormatNombre& format = FormatNombre());
+    // Texte aligné à droite : chiffres, lettres affichables, espace, '-', '_'...
+    // Un '.' allume le point décimal du caractère qui le précède
+    void displayText(std::string_view text);
     void displayDateTime();
+    // Dans une Tache : co_await panneau.show(texte, duree) affiche le texte
+    // puis attend 'duree' sans bloquer l'ordonnanceur
+    Delai show(std::string_view text, std::chrono::milliseconds duree = std::chrono::milliseconds(0));
+    // Scénario de displayDateTime(), à confier à un OrdonnanceurAffichage
+    Tache showDateTime();
+    
+    // Trame brute (un octet de segments par afficheur), envoyée sans
+    // modifier la luminosité
+    void displayFrame(const uint8_t* octets);
+    // Conversion sans envoi dans 'octets' (getNbAfficheurs() octets), pour
+    // préparer une trame depuis un autre thread (voir FileAffichage). En cas
+    // d'exception, 'octets' n'est pas modifié
+    void encodeText(std::string_view text, uint8_t* octets) const;
+    template<typename T, typename std::enable_if<std::is_integral<T>::value &&
+                                                 !std::is_same<T, bool>::value &&
+                                                 !std::is_same<T, char>::value, int>::type = 0>
+    void encodeNumber(T value, uint8_t* octets, const FormatNombre& format = FormatNombre()) const {
+        uint64_t magnitude;
+        bool negative;
+        split(value, magnitude, negative);
+        encodeInteger(magnitude, negative, format, octets);
+    }
+    int getNbAfficheurs() const;
+    
+    // Mode horloge : un thread réveillé en temps absolu au début de chaque
+    // seconde (ou minute si rien ne change entre deux minutes) affiche
+    // l'heure. La trame n'est envoyée que si les chiffres visibles changent,
+    // sans modifier la luminosité (voir setBrightness). Un appel à display...()
+    // pendant le mode horloge est remplacé au changement suivant.
+    void startClock(const OptionsHorloge& options = OptionsHorloge());
+    void stopClock();
+    
+    // Mode balayage, pour les panneaux multiplexés (un octet de segments et
+    // des octets de sélection des afficheurs sur la chaine, voir
+    // BalayageAffichage) : un thread temps réel rafraîchit les afficheurs un
+    // par un, les appels display...() ne font plus que déposer la trame,
+    // sans attendre ni modifier la luminosité. Avec une MLI logicielle sur
+    // OE, préférer une fréquence de balayage multiple de celle de la MLI
+    void startScan(const OptionsBalayage& options = OptionsBalayage());
+    void stopScan();
+    StatistiquesBalayage getScanStats() const;
+    
+    // Lecture d'une animation précompilée (voir AnimationAffichage) par un
+    // thread réveillé à l'échéance de chaque étape. Les étapes déjà
+    // dépassées sont sautées (seules leurs modifications sont reprises), la
+    // trame de chaque étape est envoyée directement depuis le fichier
+    // projeté. L'animation doit exister jusqu'à stopAnimation() ; le mode
+    // horloge est arrêté. Une fois l'animation terminée, la dernière trame
+    // reste affichée
+    void play(const AnimationAffichage& animation, const OptionsLecture& options = OptionsLecture());
+    // Reprise de la lecture à la position indiquée
+    void seek(std::chrono::milliseconds position);
+    void stopAnimation();
+    bool isPlaying();
+    StatistiquesLecture getPlaybackStats();
     
 private:
     
     
-    CGPIO* oe;
-    CGPIO* le;
-    CGPIO* data;
-    CGPIO* clk;
+    // OE est pilotée par le moteur de luminosité, depuis son propre thread ;
+    // LE, DATA et CLK forment un port (LE seule avec un transport)
+    // Possédés par le panneau : créés par init(), libérés par close()
+    std::unique_ptr<CGPIO> oe;
+    std::unique_ptr<CGPIOPort> port;
+    CGPIOBackend* backend;
+    CShiftTransport* transport;
+    std::unique_ptr<MoteurLuminosite> luminosite;
+    // Thread de balayage, seul à utiliser le port en mode balayage
+    BalayageAffichage* balayage;
+    CPWM* pwm;
+    bool pwmMateriel;
     
     int nbAfficheurs;
     int pinOE, pinLE, pinData, pinClk;
+    // Lignes DATA (pinData est la première)
+    vector<int> pinsData;
     bool isInitialized;
     
-    void sendOneByte(int value);
+    // Trame en cours et séquence d'écritures précalculée sur le port
+    // {LE, DATA, CLK} (bit 0 à 2 des masques), ou {LE, CLK, DATA...} avec
+    // plusieurs lignes DATA
+    TrameAffichage trame;
+    const uint16_t* police;
+    uint8_t pointDecimal;
+    vector<CGPIOStep> steps;
+    // Protège la trame, modifiée par les appels display...() et par le
+    // thread du mode horloge, et le passage en mode balayage
+    std::mutex mutexTrame;
+    
+    std::thread threadHorloge;
+    std::mutex mutexHorloge;
+    std::condition_variable conditionHorloge;
+    bool horlogeActive;
+    OptionsHorloge optionsHorloge;
+    
+    std::thread threadAnimation;
+    std::mutex mutexAnimation;
+    std::condition_variable conditionAnimation;
+    bool animationActive;
+    const AnimationAffichage* animation;
+    OptionsLecture optionsLecture;
+    int64_t demandePosition;    // position demandée par seek() (-1 : aucune)
+    StatistiquesLecture statistiquesLecture;
+    
+    template<typename T>
+    static void split(T value, uint64_t& magnitude, bool& negative) {
+        if constexpr (std::is_signed<T>::value) {
+            magnitude = (uint64_t)(int64_t)value;
+            negative = value < 0;
+            if (negative)
+                magnitude = 0 - magnitude;
+        }
+        else {
+            magnitude = value;
+            negative = false;
+        }
+    }
+    void displayInteger(uint64_t magnitude, bool negative, const FormatNombre& format);
+    void encodeInteger(uint64_t magnitude, bool negative, const FormatNombre& format, uint8_t* octets) const;
+    void fillDigits(const char* chiffres, int n, bool negative, const FormatNombre& format, uint8_t* octets) const;
+    void runClock();
+    void renderClock(const struct tm& tm, time_t t);
+    void runAnimation();
+    void playStep(const AnimationAffichage& animation, size_t i, uint8_t changements);
+    // disable : sorties désactivées pendant l'envoi (comportement historique
+    // des méthodes display...()), sinon la luminosité est conservée
+    void pushFrame(bool disable = true);
+    // Envoi de n'importe quels octets (sans comparaison avec la dernière
+    // trame verrouillée), mutexTrame doit être verrouillé
+    void sendFrame(const uint8_t* octets, bool disable);
     void latchValue();
     void outputEnable();
     void outputDisable();
@@ -0,0 +1,194 @@
+/*
+ * File:   PanneauStatique.h
+ * Author: olivier
+ *
+ * Panneau dont le câblage et le nombre d'afficheurs sont connus à la
+ * compilation :
+ *
+ *   CGPIOMmapBackend registres;
+ *   PanneauStatique<CGPIOMmapBackend, 18, 22, 10, 11, 4> panneau(registres);
+ *   panneau.displayText("12.34");
+ *   panneau.outputEnable();
+ *
+ * Les vérifications faites par PanneauAffichage::init() (broches
+ * positives, toutes différentes, existantes sur le bloc GPIO) deviennent
+ * des static_assert. Les broches sont réservées par le constructeur et
+ * libérées par le destructeur (le panneau peut être déplacé, pas copié).
+ *
+ * Les écritures ne passent plus par l'interface virtuelle CGPIOBackend :
+ * avec une méthode d'accés qui fournit setBits()/clearBits()
+ * (CGPIOMmapBackend), les banques et les masques des broches sont des
+ * constantes et l'envoi d'une trame se réduit à une suite d'écritures dans
+ * les registres GPSET/GPCLR, sans boucle sur les bits. Les autres
+ * méthodes d'accés sont appelées par writeValue(), sans appel virtuel.
+ *
+ * Il n'y a ni moteur de luminosité (OE est seulement activée ou
+ * désactivée), ni instrumentation, ni enregistrement des broches : pour
+ * tout cela, utiliser PanneauAffichage.
+ */
+
+#ifndef PANNEAUSTATIQUE_H
+#define	PANNEAUSTATIQUE_H
+
+#include <cstdint>
+#include <climits>
+#include <string_view>
+#include <utility>
+#include "GPIOClass.h"
+#include "PanneauAffichage.h"
+#include "Police7Segments.h"
+
+// Broche en sortie réservée pendant toute la vie de l'objet
+class BrocheReservee {
+public:
+    BrocheReservee(int num, bool high, CGPIOBackend* backend)
+        : broche(num, CGPIO::CGPIODirection::OUT, high ? CGPIO::CGPIOValue::HIGH : CGPIO::CGPIOValue::LOW, backend) {
+        if (!this->broche.init())
+            throw (PanneauAffichage::Erreur(this->broche.getLastError()));
+        this->reservee = true;
+    }
+    BrocheReservee(BrocheReservee&& autre) noexcept
+        : broche(std::move(autre.broche)), reservee(std::exchange(autre.reservee, false)) {}
+    BrocheReservee& operator=(BrocheReservee&& autre) noexcept {
+        if (this != &autre) {
+            liberer();
+            this->broche = std::move(autre.broche);
+            this->reservee = std::exchange(autre.reservee, false);
+        }
+        return *this;
+    }
+    BrocheReservee(const BrocheReservee&) = delete;
+    BrocheReservee& operator=(const BrocheReservee&) = delete;
+    ~BrocheReservee() {
+        liberer();
+    }
+
+private:
+    CGPIO broche;
+    bool reservee;
+
+    void liberer() {
+        if (this->reservee)
+            this->broche.close();
+        this->reservee = false;
+    }
+};
+
+template<typename Backend, int OE, int LE, int DATA, int CLK, int N, Orientation O = Orientation::DPBas>
+class PanneauStatique {
+    // Broches du bloc GPIO, si la méthode d'accés en déclare le nombre
+    static constexpr int nbBroches() {
+        if constexpr (requires { Backend::nbPins; })
+            return Backend::nbPins;
+        else
+            return INT_MAX;
+    }
+    // Ecriture directe dans les registres
+    static constexpr bool parRegistres = requires(Backend& b) {
+        b.setBits(0, 0u);
+        b.clearBits(0, 0u);
+    };
+
+    static_assert(N >= 1, "Le nombre d'afficheur doit être supérieur ou égale à 1");
+    static_assert(OE >= 0 && LE >= 0 && DATA >= 0 && CLK >= 0, "Une broche ne peut avoir une valeur negative");
+    static_assert(OE != LE && OE != DATA && OE != CLK && LE != DATA && LE != CLK && DATA != CLK,
+                  "Les numeros de broche doivent être tous différents");
+    static_assert(OE < nbBroches() && LE < nbBroches() && DATA < nbBroches() && CLK < nbBroches(),
+                  "Broche absente du bloc GPIO");
+
+public:
+    // Réserve les broches (sorties désactivées), lève une exception
+    // PanneauAffichage::Erreur en cas de problème
+    explicit PanneauStatique(Backend& backend)
+        : backend(&backend),
+          oe(OE, true, &backend),
+          le(LE, false, &backend),
+          data(DATA, false, &backend),
+          clk(CLK, false, &backend) {}
+
+    PanneauStatique(PanneauStatique&&) noexcept = default;
+    PanneauStatique& operator=(PanneauStatique&&) noexcept = default;
+
+    static constexpr int getNbAfficheurs() {
+        return N;
+    }
+
+    // Trame brute (N octets de segments, le premier pour l'afficheur le
+    // plus à gauche), envoyée sans modifier OE
+    void displayFrame(const uint8_t* octets) {
+        for (int k = 0; k < N; k++)
+            envoyerOctet(octets[k], std::make_index_sequence<8>());
+        // Front montant de LE : registres à décalage vers les sorties
+        ecrire<CLK>(false);
+        ecrire<LE>(true);
+        ecrire<LE>(false);
+    }
+
+    // Texte aligné à droite (voir PanneauAffichage::displayText)
+    void displayText(std::string_view text) {
+        uint8_t octets[N];
+        char invalide;
+        switch (encoderTexte(text, Police7Segments<O>::table.data(), Police7Segments<O>::pointDecimal,
+                             octets, N, invalide)) {
+            case ResultatTexte::CaractereInvalide:
+                throw (PanneauAffichage::Erreur(string("Caractère non affichable : ") + invalide));
+            case ResultatTexte::TropLong:
+                throw (PanneauAffichage::Erreur("Texte trop long pour être affiché"));
+            default:
+                break;
+        }
+        displayFrame(octets);
+    }
+
+    // OE est active à l'état bas
+    void outputEnable() {
+        ecrire<OE>(false);
+    }
+    void outputDisable() {
+        ecrire<OE>(true);
+    }
+
+private:
+    Backend* backend;
+    // Libérées dans l'ordre inverse de leur réservation
+    BrocheReservee oe, le, data, clk;
+
+    template<int P>
+    void ecrire(bool high) {
+        if constexpr (parRegistres) {
+            if (high)
+                this->backend->setBits(P / 32, 1u << (P % 32));
+            else
+                this->backend->clearBits(P / 32, 1u << (P % 32));
+        }
+        else
+            this->backend->Backend::writeValue(P, high);
+    }
+
+    // DATA positionnée avec le front descendant de CLK (une seule écriture
+    // si elle passe à l'état bas dans la même banque), puis front montant
+    void envoyerBit(bool bit) {
+        if constexpr (parRegistres && DATA / 32 == CLK / 32) {
+            if (bit) {
+                this->backend->setBits(DATA / 32, 1u << (DATA % 32));
+                this->backend->clearBits(CLK / 32, 1u << (CLK % 32));
+            }
+            else
+                this->backend->clearBits(CLK / 32, (1u << (CLK % 32)) | (1u << (DATA % 32)));
+        }
+        else {
+            ecrire<CLK>(false);
+            ecrire<DATA>(bit);
+        }
+        ecrire<CLK>(true);
+    }
+
+    // Bit de poids faible en premier, les 8 bits déroulés
+    template<size_t... I>
+    void envoyerOctet(uint8_t valeur, std::index_sequence<I...>) {
+        (envoyerBit((valeur >> I) & 0x01), ...);
+    }
+};
+
+#endif	/* PANNEAUSTATIQUE_H */
+
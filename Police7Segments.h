@@ -0,0 +1,167 @@
+/*
+ * File:   Police7Segments.h
+ * Author: olivier
+ *
+ * Police des afficheurs 7 segments, entièrement calculée à la compilation.
+ *
+ * Les glyphes sont décrits avec les segments standards (a en haut, puis b,
+ * c, d, e, f dans le sens horaire, g au milieu, dp le point décimal) puis
+ * convertis selon le câblage des afficheurs sur le registre à décalage :
+ * - DPBas : câblage d'origine, point décimal en bas à droite ;
+ * - DPHaut : afficheur monté retourné, point décimal en haut à gauche,
+ *   chaque segment est donc remplacé par son symétrique (a <-> d...).
+ *
+ * La table est indexée directement par l'octet du caractère (256 entrées,
+ * aucun test de borne) ; le bit 'valide' distingue un caractère non
+ * supporté d'un afficheur éteint (espace).
+ */
+
+#ifndef POLICE7SEGMENTS_H
+#define	POLICE7SEGMENTS_H
+
+#include <cstdint>
+#include <array>
+#include <string_view>
+
+enum class Orientation : uint8_t {
+    DPBas,      // point décimal en bas (câblage d'origine)
+    DPHaut      // afficheur retourné, point décimal en haut
+};
+
+namespace Segment {
+    constexpr uint8_t A = 0x01, B = 0x02, C = 0x04, D = 0x08,
+                      E = 0x10, F = 0x20, G = 0x40, DP = 0x80;
+}
+
+template<Orientation O>
+class Police7Segments {
+public:
+    // Bit indiquant que le caractère est supporté
+    static constexpr uint16_t valide = 0x100;
+
+    // Glyphe standard d'un caractère, -1 s'il n'est pas supporté
+    static constexpr int glyphe(char c) {
+        using namespace Segment;
+        switch (c) {
+            case '0': case 'O': return A|B|C|D|E|F;
+            case '1':           return B|C;
+            case '2': case 'Z': case 'z': return A|B|D|E|G;
+            case '3':           return A|B|C|D|G;
+            case '4':           return B|C|F|G;
+            case '5': case 'S': case 's': return A|C|D|F|G;
+            case '6':           return A|C|D|E|F|G;
+            case '7':           return A|B|C;
+            case '8': case 'B': return A|B|C|D|E|F|G;
+            case '9': case 'g': return A|B|C|D|F|G;
+            case 'A': case 'a': return A|B|C|E|F|G;
+            case 'b':           return C|D|E|F|G;
+            case 'C':           return A|D|E|F;
+            case 'c':           return D|E|G;
+            case 'D': case 'd': return B|C|D|E|G;
+            case 'E': case 'e': return A|D|E|F|G;
+            case 'F': case 'f': return A|E|F|G;
+            case 'G':           return A|C|D|E|F;
+            case 'H':           return B|C|E|F|G;
+            case 'h':           return C|E|F|G;
+            case 'I':           return E|F;
+            case 'i':           return C;
+            case 'J': case 'j': return B|C|D|E;
+            case 'L': case 'l': return D|E|F;
+            case 'N': case 'n': return C|E|G;
+            case 'o':           return C|D|E|G;
+            case 'P': case 'p': return A|B|E|F|G;
+            case 'Q': case 'q': return A|B|C|F|G;
+            case 'R': case 'r': return E|G;
+            case 'T': case 't': return D|E|F|G;
+            case 'U':           return B|C|D|E|F;
+            case 'u': case 'v': return C|D|E;
+            case 'Y': case 'y': return B|C|D|F|G;
+            case '-':           return G;
+            case '_':           return D;
+            case '=':           return D|G;
+            case '"':           return B|F;
+            case '\'':          return B;
+            case ' ':           return 0;
+            default:            return -1;
+        }
+    }
+
+    // Conversion d'un glyphe standard en octet à envoyer pour ce câblage
+    static constexpr uint8_t cabler(uint8_t g) {
+        // Position (bit du registre) de chaque segment a, b, c, d, e, f, g, dp
+        constexpr uint8_t dpBas[8]  = {1, 0, 6, 5, 4, 2, 3, 7};
+        constexpr uint8_t dpHaut[8] = {5, 4, 2, 1, 0, 6, 3, 7};
+        uint8_t octet = 0;
+        for (int s = 0; s < 8; s++)
+            if (g & (1 << s))
+                octet |= 1 << (O == Orientation::DPBas ? dpBas[s] : dpHaut[s]);
+        return octet;
+    }
+
+    // Octet du point décimal pour ce câblage
+    static constexpr uint8_t pointDecimal = cabler(Segment::DP);
+
+    // Entrée de la table : octet à envoyer (bits 0 à 7) | valide
+    static constexpr std::array<uint16_t, 256> table = []() {
+        std::array<uint16_t, 256> t{};
+        for (int c = 0; c < 256; c++) {
+            int g = glyphe((char)c);
+            t[c] = (g < 0) ? 0 : (uint16_t)(cabler((uint8_t)g) | valide);
+        }
+        return t;
+    }();
+
+    // Octets des chiffres 0 à 9 (anciennes tables numberDPDown/numberDPUp)
+    static constexpr std::array<int, 10> chiffres = []() {
+        std::array<int, 10> t{};
+        for (int i = 0; i < 10; i++)
+            t[i] = table['0' + i] & 0xFF;
+        return t;
+    }();
+};
+
+enum class ResultatTexte {
+    Ok,
+    CaractereInvalide,
+    TropLong
+};
+
+// Conversion d'un texte en octets pour n afficheurs avec la table 'police'
+// (Police7Segments<O>::table), alignée à droite et complétée par des
+// afficheurs éteints. Un '.' allume le point décimal du caractère qui le
+// précède. En cas d'échec, 'invalide' reçoit le caractère non supporté.
+inline ResultatTexte encoderTexte(std::string_view text, const uint16_t* police, uint8_t pointDecimal,
+                                  uint8_t* octets, int n, char& invalide) {
+    // Remplissage de droite à gauche : un '.' est mémorisé puis ajouté au
+    // caractère qui le précède (ou à un afficheur éteint)
+    int pos = n - 1;
+    bool point = false;
+    for (size_t i = text.size(); i-- > 0; ) {
+        uint8_t c = text[i];
+        if (c == '.' && !point) {
+            point = true;
+            continue;
+        }
+        uint16_t glyphe = (c == '.') ? police[' '] : police[c];
+        if (!(glyphe & Police7Segments<Orientation::DPBas>::valide)) {
+            invalide = (char)c;
+            return ResultatTexte::CaractereInvalide;
+        }
+        if (pos < 0)
+            return ResultatTexte::TropLong;
+        octets[pos--] = (uint8_t)glyphe | (point ? pointDecimal : 0);
+        point = (c == '.');
+    }
+    if (point) {
+        if (pos < 0)
+            return ResultatTexte::TropLong;
+        octets[pos--] = pointDecimal;
+    }
+
+    while (pos >= 0)
+        octets[pos--] = 0;
+    return ResultatTexte::Ok;
+}
+
+#endif	/* POLICE7SEGMENTS_H */
+
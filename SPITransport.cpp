@@ -0,0 +1,113 @@
+/**
+\file SPITransport.cpp
+
+\brief Implémentation de la classe CSPITransport (envoi des trames par spidev)
+*/
+#include <array>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#include "SPITransport.h"
+
+using namespace std;
+
+// Table des octets retournés (bit 0 <-> bit 7...), pour les contrôleurs sans mode LSB en premier,
+// calculée à la compilation
+static constexpr std::array<uint8_t, 256> reverseTable = [] {
+	std::array<uint8_t, 256> table{};
+	for (int i = 0; i < 256; i++) {
+		uint8_t r = 0;
+		for (int b = 0; b < 8; b++)
+			if (i & (1 << b))
+				r |= 0x80 >> b;
+		table[i] = r;
+	}
+	return table;
+}();
+
+static_assert(reverseTable[0x01] == 0x80 && reverseTable[0x0F] == 0xF0, "table des octets retournés");
+
+CSPITransport::CSPITransport(const string& path, uint32_t speedHz)
+{
+	this->path = path;
+	this->fd = -1;
+	this->speedHz = speedHz;
+	this->reverseBits = false;
+}
+
+CSPITransport::~CSPITransport()
+{
+	if (fd >= 0)
+		::close(fd);
+}
+
+bool CSPITransport::init()
+{
+	if (fd >= 0)
+		return true;
+
+	fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		error = "OPERATION FAILED: Unable to open " + path + " : " + strerror(errno) + "\n";
+		return false;
+	}
+
+	uint8_t mode = SPI_MODE_0;
+	uint8_t bits = 8;
+	if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+	    ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speedHz) < 0) {
+		error = "OPERATION FAILED: Unable to configure " + path + " : " + strerror(errno) + "\n";
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+
+	// Bit de poids faible en premier si le contrôleur le permet, sinon retournement logiciel
+	uint8_t lsb = 1;
+	reverseBits = (ioctl(fd, SPI_IOC_WR_LSB_FIRST, &lsb) < 0);
+	return true;
+}
+
+bool CSPITransport::close()
+{
+	if (fd >= 0 && ::close(fd) < 0) {
+		error = "OPERATION FAILED: Unable to close " + path + " : " + strerror(errno) + "\n";
+		fd = -1;
+		return false;
+	}
+	fd = -1;
+	return true;
+}
+
+void CSPITransport::setSpeed(uint32_t speedHz)
+{
+	this->speedHz = speedHz;
+}
+
+bool CSPITransport::send(const uint8_t* data, size_t n)
+{
+	if (reverseBits) {
+		reversed.resize(n);
+		for (size_t i = 0; i < n; i++)
+			reversed[i] = reverseTable[data[i]];
+		data = reversed.data();
+	}
+
+	struct spi_ioc_transfer tr;
+	memset(&tr, 0, sizeof(tr));
+	tr.tx_buf = (unsigned long)data;
+	tr.len = n;
+	tr.speed_hz = speedHz;
+	tr.bits_per_word = 8;
+
+	if (ioctl(fd, SPI_IOC_MESSAGE(1), &tr) < 0) {
+		error = "OPERATION FAILED: SPI transfer on " + path + " failed : " + strerror(errno) + "\n";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+/**
+\file SPITransport.h
+Déclaration de la classe CSPITransport
+\class CSPITransport
+\brief Envoi des trames par le contrôleur SPI matériel (/dev/spidevB.C)
+
+La trame complète de tous les afficheurs est envoyée par un seul transfert SPI_IOC_MESSAGE
+en mode 0 : DATA est reliée à MOSI et CLK à SCLK. L'envoi bit de poids faible en premier est
+demandé au contrôleur ; s'il ne le supporte pas (c'est le cas du BCM2835), les octets sont
+retournés par logiciel avant l'envoi.
+*/
+
+#ifndef SPI_TRANSPORT_H
+#define SPI_TRANSPORT_H
+
+#include <cstdint>
+#include "ShiftTransport.h"
+
+class CSPITransport : public CShiftTransport
+{
+public:
+	/**
+	* \brief Constructeur de la classe CSPITransport
+	* \param[in] path Chemin du périphérique spidev (par défaut /dev/spidev0.0)
+	* \param[in] speedHz Fréquence de l'horloge SPI en Hz (par défaut 1 MHz)
+	*/
+	CSPITransport(const string& path = "/dev/spidev0.0", uint32_t speedHz = 1000000);
+	virtual ~CSPITransport();
+
+	virtual bool init();
+	virtual bool close();
+	virtual bool send(const uint8_t* data, size_t n);
+
+	/**
+	* \brief Modifie la fréquence de l'horloge SPI, prise en compte au prochain envoi
+	* \param[in] speedHz Fréquence de l'horloge SPI en Hz
+	*/
+	void setSpeed(uint32_t speedHz);
+
+private:
+	/// Chemin du périphérique spidev
+	string path;
+	/// Descripteur du périphérique, -1 tant qu'il n'est pas ouvert
+	int fd;
+	/// Fréquence de l'horloge SPI en Hz
+	uint32_t speedHz;
+	/// Vrai si le contrôleur n'envoie pas le bit de poids faible en premier
+	bool reverseBits;
+	/// Tampon des octets retournés, réutilisé d'un envoi à l'autre
+	vector<uint8_t> reversed;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/**
+\file ShiftTransport.h
+Déclaration de l'interface CShiftTransport et de la classe CCaptureTransport
+\class CShiftTransport
+\brief Interface d'envoi d'une trame complète vers la chaine de registres à décalage
+
+Par défaut, un panneau envoie ses octets en pilotant lui-même les broches DATA et CLK. Les
+signaux DATA/CLK correspondent exactement à une liaison SPI en mode 0, bit de poids faible
+en premier : un objet qui implémente cette interface peut donc prendre en charge tout le
+décalage (par exemple CSPITransport pour le contrôleur SPI matériel). Les broches LE et OE
+restent pilotées par le panneau.
+
+Les octets sont transmis dans l'ordre du tableau, chaque octet bit de poids faible en premier.
+*/
+
+#ifndef SHIFT_TRANSPORT_H
+#define SHIFT_TRANSPORT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class CShiftTransport
+{
+public:
+	virtual ~CShiftTransport() {}
+
+	/**
+	* \brief Prépare le transport (ouverture du périphérique...), appelée par l'initialisation du panneau
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool init() { return true; }
+
+	/**
+	* \brief Libère le transport (fermeture du périphérique...), appelée à la fermeture du panneau
+	* ou si son initialisation échoue
+	* \return booléen qui indique si la méthode a échoué (false) ou réussi (true)
+	*/
+	virtual bool close() { return true; }
+
+	/**
+	* \brief Envoie une trame complète
+	* \param[in] data Octets à envoyer
+	* \param[in] n Nombre d'octets
+	* \return booléen qui indique si l'envoi a échoué (false) ou réussi (true)
+	*/
+	virtual bool send(const uint8_t* data, size_t n) = 0;
+
+	/**
+	* \brief Renvoie le dernier message d'erreur puis le réinitialise
+	* \return une chaine de caractère (string) qui contient le message d'erreur
+	*/
+	string getLastError()
+	{
+		string temp = this->error;
+		this->error = "No error \n";
+		return temp;
+	}
+
+protected:
+	/// cette chaine contient le dernier message d'erreur
+	string error;
+};
+
+/**
+\class CCaptureTransport
+\brief Transport local qui se contente de mémoriser les trames envoyées
+
+Il remplace le périphérique SPI pour tester un panneau ou mesurer ses performances sans carte.
+*/
+class CCaptureTransport : public CShiftTransport
+{
+public:
+	virtual bool send(const uint8_t* data, size_t n)
+	{
+		last.assign(data, data + n);
+		frames++;
+		return true;
+	}
+
+	/// Dernière trame envoyée
+	vector<uint8_t> last;
+	/// Nombre de trames envoyées
+	unsigned long frames = 0;
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * File:   TamponAffichage.cpp
+ * Author: olivier
+ */
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <grp.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "TamponAffichage.h"
+#include "PanneauAffichage.h"
+
+const uint32_t TamponAffichage::magic;
+const uint32_t TamponAffichage::version;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "atomiques partagés entre processus");
+
+// Futex partagé entre processus (pas de FUTEX_PRIVATE_FLAG)
+static long futex(std::atomic<uint32_t>* adresse, int operation, uint32_t valeur, const struct timespec* delai) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(adresse), operation, valeur, delai, nullptr, 0);
+}
+
+TamponAffichage::TamponAffichage(const string& nom, bool proprietaire, void* adresse, size_t taille) {
+    this->nom = nom;
+    this->proprietaire = proprietaire;
+    this->adresse = adresse;
+    this->taille = taille;
+    this->entete = static_cast<EnTete*>(adresse);
+    this->panneaux = reinterpret_cast<Panneau*>(static_cast<uint8_t*>(adresse) + sizeof(EnTete));
+}
+
+TamponAffichage::~TamponAffichage() {
+    munmap(this->adresse, this->taille);
+    if (this->proprietaire)
+        shm_unlink(this->nom.c_str());
+}
+
+std::unique_ptr<TamponAffichage> TamponAffichage::create(const string& nom, const vector<int>& nbAfficheurs,
+                                                        const string& groupe) {
+    if (nbAfficheurs.empty())
+        throw (PanneauAffichage::Erreur("Le tampon partagé doit contenir au moins un panneau"));
+
+    size_t taille = sizeof(EnTete) + nbAfficheurs.size() * sizeof(Panneau);
+    for (int n : nbAfficheurs) {
+        if (n < 1)
+            throw (PanneauAffichage::Erreur("Le nombre d\'afficheur doit être supérieur ou égale à 1"));
+        taille += n;
+    }
+
+    gid_t gid = (gid_t)-1;
+    if (!groupe.empty()) {
+        struct group* g = getgrnam(groupe.c_str());
+        if (g == nullptr)
+            throw (PanneauAffichage::Erreur("Groupe inconnu : " + groupe));
+        gid = g->gr_gid;
+    }
+
+    shm_unlink(nom.c_str());
+    int fd = shm_open(nom.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    if (fd < 0)
+        throw (PanneauAffichage::Erreur("Impossible de créer le tampon " + nom + " : " + strerror(errno)));
+    // Accessible aux seuls membres du groupe, quel que soit le umask du démon
+    if ((gid != (gid_t)-1 && fchown(fd, (uid_t)-1, gid) != 0) || fchmod(fd, 0660) != 0) {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(nom.c_str());
+        throw (PanneauAffichage::Erreur("Impossible de protéger le tampon " + nom + " : " + strerror(err)));
+    }
+    if (ftruncate(fd, taille) != 0) {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(nom.c_str());
+        throw (PanneauAffichage::Erreur("Impossible de dimensionner le tampon " + nom + " : " + strerror(err)));
+    }
+    void* adresse = mmap(nullptr, taille, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (adresse == MAP_FAILED) {
+        shm_unlink(nom.c_str());
+        throw (PanneauAffichage::Erreur("Impossible de projeter le tampon " + nom + " : " + strerror(errno)));
+    }
+
+    // Le fichier est rempli de zéros : séquences paires, trames éteintes.
+    // L'en-tête est écrit en dernier, un client qui ouvre le tampon trop tôt
+    // le refuse
+    std::unique_ptr<TamponAffichage> tampon(new TamponAffichage(nom, true, adresse, taille));
+    uint32_t position = sizeof(EnTete) + nbAfficheurs.size() * sizeof(Panneau);
+    for (size_t i=0; i<nbAfficheurs.size(); i++) {
+        Panneau& p = tampon->panneaux[i];
+        p.luminosite.store(-1, std::memory_order_relaxed);
+        p.nbAfficheurs = nbAfficheurs[i];
+        p.position = position;
+        position += nbAfficheurs[i];
+    }
+    EnTete* e = tampon->entete;
+    e->version = version;
+    e->nbPanneaux = nbAfficheurs.size();
+    e->taille = taille;
+    std::atomic_thread_fence(std::memory_order_release);
+    e->magic = magic;
+    return tampon;
+}
+
+std::unique_ptr<TamponAffichage> TamponAffichage::open(const string& nom) {
+    int fd = shm_open(nom.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+        throw (PanneauAffichage::Erreur("Impossible d\'ouvrir le tampon " + nom + " : " + strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EnTete)) {
+        ::close(fd);
+        throw (PanneauAffichage::Erreur("Le tampon " + nom + " n\'est pas initialisé"));
+    }
+    void* adresse = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (adresse == MAP_FAILED)
+        throw (PanneauAffichage::Erreur("Impossible de projeter le tampon " + nom + " : " + strerror(errno)));
+
+    std::unique_ptr<TamponAffichage> tampon(new TamponAffichage(nom, false, adresse, st.st_size));
+    const EnTete* e = tampon->entete;
+    if (e->magic != magic || e->version != version || e->taille != (size_t)st.st_size)
+        throw (PanneauAffichage::Erreur("Le tampon " + nom + " n\'est pas un tampon d\'afficheurs valide"));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return tampon;
+}
+
+int TamponAffichage::getPanelCount() const {
+    return this->entete->nbPanneaux;
+}
+
+int TamponAffichage::getNbAfficheurs(int panneau) const {
+    return this->panneaux[panneau].nbAfficheurs;
+}
+
+uint8_t* TamponAffichage::octets(int panneau) const {
+    return static_cast<uint8_t*>(this->adresse) + this->panneaux[panneau].position;
+}
+
+void TamponAffichage::write(int panneau, const uint8_t* octets) {
+    typedef std::chrono::steady_clock horloge;
+    Panneau& p = this->panneaux[panneau];
+
+    // Séquence impaire : écriture en cours, les autres clients attendent.
+    // Une séquence restée impaire pendant delaiReprise est celle d'un
+    // client mort en pleine écriture : elle est reprise (en restant
+    // impaire) au lieu d'attendre indéfiniment
+    uint32_t sequence = p.sequence.load(std::memory_order_relaxed);
+    uint32_t observee = sequence;
+    horloge::time_point depuis = horloge::now();
+    for (;;) {
+        bool libre = (sequence & 1) == 0;
+        if (libre || (sequence == observee && horloge::now() - depuis >= delaiReprise)) {
+            uint32_t prise = libre ? sequence + 1 : sequence + 2;
+            if (p.sequence.compare_exchange_weak(sequence, prise, std::memory_order_acquire)) {
+                sequence = prise;
+                break;
+            }
+            continue;
+        }
+        if (sequence != observee) {
+            observee = sequence;
+            depuis = horloge::now();
+        }
+        std::this_thread::yield();
+        sequence = p.sequence.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(this->octets(panneau), octets, p.nbAfficheurs);
+    p.sequence.store(sequence + 1, std::memory_order_release);
+    signal();
+}
+
+void TamponAffichage::setBrightness(int panneau, int level) {
+    this->panneaux[panneau].luminosite.store(level, std::memory_order_relaxed);
+    signal();
+}
+
+bool TamponAffichage::read(int panneau, uint8_t* octets, uint32_t& sequence) const {
+    const Panneau& p = this->panneaux[panneau];
+    for (;;) {
+        uint32_t debut = p.sequence.load(std::memory_order_acquire);
+        // Ecriture en cours : le client réveillera le démon une fois la
+        // trame déposée
+        if (debut == sequence || (debut & 1))
+            return false;
+        memcpy(octets, this->octets(panneau), p.nbAfficheurs);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (p.sequence.load(std::memory_order_relaxed) == debut) {
+            sequence = debut;
+            return true;
+        }
+    }
+}
+
+int TamponAffichage::getBrightness(int panneau) const {
+    return this->panneaux[panneau].luminosite.load(std::memory_order_relaxed);
+}
+
+uint32_t TamponAffichage::getGeneration() const {
+    return this->entete->generation.load(std::memory_order_acquire);
+}
+
+void TamponAffichage::signal() {
+    // Ordre total entre l'incrément et la lecture de 'attente' d'un côté,
+    // l'écriture de 'attente' et la relecture de la génération de l'autre :
+    // un réveil ne peut pas être perdu
+    this->entete->generation.fetch_add(1, std::memory_order_seq_cst);
+    if (this->entete->attente.load(std::memory_order_seq_cst) != 0)
+        futex(&this->entete->generation, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+void TamponAffichage::notify() {
+    signal();
+}
+
+void TamponAffichage::wait(uint32_t generation, std::chrono::milliseconds timeout) {
+    struct timespec delai;
+    delai.tv_sec = timeout.count() / 1000;
+    delai.tv_nsec = (timeout.count() % 1000) * 1000000L;
+
+    this->entete->attente.store(1, std::memory_order_seq_cst);
+    // FUTEX_WAIT ne dort que si la génération vaut toujours 'generation'
+    if (this->entete->generation.load(std::memory_order_seq_cst) == generation)
+        futex(&this->entete->generation, FUTEX_WAIT, generation, &delai);
+    this->entete->attente.store(0, std::memory_order_relaxed);
+}
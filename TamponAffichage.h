@@ -0,0 +1,113 @@
+/*
+ * File:   TamponAffichage.h
+ * Author: olivier
+ *
+ * Tampon de trames partagé entre processus (mémoire partagée POSIX,
+ * /dev/shm/<nom>) : un démon (voir DemonAffichage) est le seul à posséder
+ * les panneaux et leurs broches, les autres processus écrivent leurs
+ * trames directement dans le tampon, sans appel système.
+ *
+ * Chaque panneau a sa trame et sa luminosité, protégées par un verrou de
+ * séquence (seqlock) :
+ * - un client rend la séquence impaire (échange atomique, ce qui exclut
+ *   les autres clients), écrit la trame puis la rend paire de nouveau ;
+ * - le démon copie la trame et ne la garde que si la séquence, paire,
+ *   n'a pas changé pendant la copie.
+ * Le démon dort sur un futex posé sur un compteur de génération du
+ * tampon : un client ne fait l'appel système FUTEX_WAKE que si le démon
+ * attend.
+ *
+ * Un client qui meurt en pleine écriture laisse la séquence impaire : le
+ * démon ignore le panneau (sans attendre) et le client suivant reprend
+ * l'écriture après delaiReprise.
+ *
+ * Le tampon n'est accessible qu'au propriétaire du démon et aux membres
+ * de son groupe (mode 0660) : un processus quelconque ne peut ni bloquer
+ * ni modifier les panneaux.
+ */
+
+#ifndef TAMPONAFFICHAGE_H
+#define	TAMPONAFFICHAGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class TamponAffichage {
+public:
+    // Séquence impaire au-delà de laquelle l'écrivain est considéré mort
+    static constexpr std::chrono::milliseconds delaiReprise{100};
+
+    // Création par le démon : un panneau par élément de 'nbAfficheurs'.
+    // Un tampon existant du même nom est remplacé. groupe : groupe des
+    // clients autorisés (celui du démon si vide)
+    static std::unique_ptr<TamponAffichage> create(const string& nom, const vector<int>& nbAfficheurs,
+                                                   const string& groupe = "");
+    // Ouverture par un client d'un tampon créé par le démon
+    static std::unique_ptr<TamponAffichage> open(const string& nom);
+    // Les méthodes create() et open() lèvent une exception
+    // PanneauAffichage::Erreur en cas de problème
+    virtual ~TamponAffichage();
+
+    int getPanelCount() const;
+    int getNbAfficheurs(int panneau) const;
+
+    // Côté client : dépôt d'une trame (un octet de segments par afficheur)
+    // et de la luminosité, sans appel système sauf pour réveiller le démon
+    void write(int panneau, const uint8_t* octets);
+    void setBrightness(int panneau, int level);
+
+    // Côté démon : copie la trame dans 'octets' si elle a changé depuis
+    // 'sequence' (mise à jour), renvoie false sinon ou si une écriture est
+    // en cours
+    bool read(int panneau, uint8_t* octets, uint32_t& sequence) const;
+    // Luminosité demandée, -1 si aucune depuis la création du tampon
+    int getBrightness(int panneau) const;
+    // Génération courante, incrémentée à chaque dépôt
+    uint32_t getGeneration() const;
+    // Attend que la génération diffère de 'generation' ou que le délai
+    // expire (ou qu'un signal interrompe l'attente)
+    void wait(uint32_t generation, std::chrono::milliseconds timeout);
+    // Réveille le démon sans rien déposer (arrêt)
+    void notify();
+
+private:
+    static const uint32_t magic = 0x37534547;   // "7SEG"
+    static const uint32_t version = 1;
+
+    struct EnTete {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t nbPanneaux;
+        uint32_t taille;
+        std::atomic<uint32_t> generation;
+        std::atomic<uint32_t> attente;
+    };
+
+    struct Panneau {
+        std::atomic<uint32_t> sequence;
+        std::atomic<int32_t> luminosite;
+        uint32_t nbAfficheurs;
+        uint32_t position;          // position de la trame depuis le début du tampon
+    };
+
+    string nom;
+    bool proprietaire;
+    void* adresse;
+    size_t taille;
+    EnTete* entete;
+    Panneau* panneaux;
+
+    TamponAffichage(const string& nom, bool proprietaire, void* adresse, size_t taille);
+    uint8_t* octets(int panneau) const;
+    void signal();
+};
+
+#endif	/* TAMPONAFFICHAGE_H */
+
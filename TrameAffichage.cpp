@@ -0,0 +1,157 @@
+/*
+ * File:   TrameAffichage.cpp
+ * Author: olivier
+ */
+#include <algorithm>
+#include "TrameAffichage.h"
+
+TrameAffichage::TrameAffichage(int nbAfficheurs)
+    : trame(std::max(nbAfficheurs, 0), 0), latched(std::max(nbAfficheurs, 0), 0) {
+    this->latchedValid = false;
+}
+
+int TrameAffichage::size() const {
+    return this->trame.size();
+}
+
+uint8_t* TrameAffichage::bytes() {
+    return this->trame.data();
+}
+
+const uint8_t* TrameAffichage::bytes() const {
+    return this->trame.data();
+}
+
+void TrameAffichage::clear() {
+    std::fill(this->trame.begin(), this->trame.end(), 0);
+}
+
+bool TrameAffichage::isLatched() const {
+    return this->latchedValid && this->trame == this->latched;
+}
+
+void TrameAffichage::latch() {
+    this->latched = this->trame;
+    this->latchedValid = true;
+}
+
+void TrameAffichage::invalidate() {
+    this->latchedValid = false;
+}
+
+void TrameAffichage::compile(vector<CGPIOStep>& steps, const Broches& broches) const {
+    steps.clear();
+    append(steps, this->trame.data(), this->trame.size(), broches);
+}
+
+void TrameAffichage::append(vector<CGPIOStep>& steps, const uint8_t* octets, size_t n, const Broches& broches) {
+    size_t debut = steps.size();
+    steps.resize(debut + n * 16 + 2);
+    CGPIOStep* step = steps.data() + debut;
+
+    // Le niveau de DATA n'est pas connu au départ : il est toujours écrit
+    // pour le premier bit, puis seulement quand il change
+    int data = -1;
+    bool first = true;
+    for (size_t k=0; k<n; k++) {
+        uint8_t value = octets[k];
+        for (int i=0; i<8; i++) {
+            int bit = (value >> i) & 0x01;
+            step->setMask = first ? broches.oe : 0;
+            step->clearMask = broches.clk;
+            if (bit != data) {
+                if (bit)
+                    step->setMask |= broches.data;
+                else
+                    step->clearMask |= broches.data;
+                data = bit;
+            }
+            step++;
+            step->setMask = broches.clk;
+            step->clearMask = 0;
+            step++;
+            first = false;
+        }
+    }
+
+    // Front montant de LE (en même temps que CLK repasse à l'état bas)
+    // pour transférer les registres à décalage vers les sorties
+    step->setMask = broches.le | (first ? broches.oe : 0);
+    step->clearMask = broches.clk;
+    step++;
+    step->setMask = 0;
+    step->clearMask = broches.le;
+}
+
+// Transposition d'une matrice de 8x8 bits rangée dans un mot de 64 bits
+// (octet j = ligne j) : le bit i de l'octet j passe au bit j de l'octet i.
+// Trois étapes d'échanges de blocs (1, 2 puis 4 bits), sans boucle
+static inline uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+void TrameAffichage::compileSlices(vector<CGPIOStep>& steps, const BrochesParalleles& broches) const {
+    steps.clear();
+    appendSlices(steps, this->trame.data(), this->trame.size(), broches);
+}
+
+void TrameAffichage::appendSlices(vector<CGPIOStep>& steps, const uint8_t* octets, size_t n,
+                                  const BrochesParalleles& broches) {
+    int lignes = std::max(broches.nbLignes, 1);
+    size_t longueur = (n + lignes - 1) / lignes;
+    int groupes = (lignes + 7) / 8;
+    uint32_t masqueData = (lignes >= 32 ? 0xFFFFFFFFu : (1u << lignes) - 1) << broches.data;
+
+    size_t debut = steps.size();
+    steps.resize(debut + longueur * 16 + 2);
+    CGPIOStep* step = steps.data() + debut;
+
+    // Comme pour append(), les lignes DATA sont toutes écrites pour le
+    // premier bit, puis seulement celles qui changent
+    uint32_t data = 0;
+    bool first = true;
+    for (size_t b=0; b<longueur; b++) {
+        // Bits 0 à 7 des octets de rang b, une ligne DATA par bit
+        uint32_t bits[8] = {};
+        for (int g=0; g<groupes; g++) {
+            uint64_t bloc = 0;
+            for (int j=0; j<8 && 8 * g + j < lignes; j++) {
+                int ligne = 8 * g + j;
+                size_t fin = std::min(n, (ligne + 1) * longueur);
+                size_t taille = fin > ligne * longueur ? fin - ligne * longueur : 0;
+                // Bourrage en tête des sous-chaines plus courtes
+                if (b >= longueur - taille)
+                    bloc |= (uint64_t)octets[ligne * longueur + b - (longueur - taille)] << (8 * j);
+            }
+            bloc = transpose8x8(bloc);
+            for (int i=0; i<8; i++)
+                bits[i] |= (uint32_t)((bloc >> (8 * i)) & 0xFF) << (8 * g);
+        }
+
+        for (int i=0; i<8; i++) {
+            uint32_t valeur = (bits[i] << broches.data) & masqueData;
+            uint32_t change = first ? masqueData : (valeur ^ data);
+            step->setMask = valeur & change;
+            step->clearMask = broches.clk | (~valeur & change);
+            step++;
+            step->setMask = broches.clk;
+            step->clearMask = 0;
+            step++;
+            data = valeur;
+            first = false;
+        }
+    }
+
+    step->setMask = broches.le;
+    step->clearMask = broches.clk;
+    step++;
+    step->setMask = 0;
+    step->clearMask = broches.le;
+}
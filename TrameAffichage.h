@@ -0,0 +1,88 @@
+/*
+ * File:   TrameAffichage.h
+ * Author: olivier
+ *
+ * Trame d'un panneau : un octet de segments par afficheur, dans l'ordre
+ * d'envoi sur la chaine de registres à décalage (le premier octet envoyé
+ * est celui de l'afficheur le plus à gauche).
+ *
+ * La trame est "compilée" en une séquence d'écritures sur les broches
+ * (CGPIOStep) que la méthode d'accés rejoue d'une traite. La dernière
+ * trame verrouillée est mémorisée pour éviter de renvoyer une trame
+ * identique.
+ */
+
+#ifndef TRAMEAFFICHAGE_H
+#define	TRAMEAFFICHAGE_H
+
+#include <cstdint>
+#include <vector>
+#include "GPIOBackend.h"
+
+class TrameAffichage {
+public:
+    // Masques des broches du registre à décalage dans le groupe de broches
+    // utilisé pour rejouer la séquence (voir CGPIOBackend::writeSequence)
+    struct Broches {
+        uint32_t oe;
+        uint32_t le;
+        uint32_t data;
+        uint32_t clk;
+    };
+
+    // Envoi en parallèle sur plusieurs sous-chaines : une ligne DATA par
+    // sous-chaine, toutes cadencées par la même horloge CLK. Les lignes
+    // DATA occupent les bits consécutifs à partir du bit 'data'
+    struct BrochesParalleles {
+        uint32_t le;
+        uint32_t clk;
+        int data;
+        int nbLignes;
+    };
+
+    TrameAffichage(int nbAfficheurs);
+
+    int size() const;
+    uint8_t* bytes();
+    const uint8_t* bytes() const;
+
+    // Eteint tous les afficheurs de la trame
+    void clear();
+
+    // Vrai si la trame est identique à la dernière trame verrouillée
+    bool isLatched() const;
+    // Mémorise la trame comme dernière trame verrouillée
+    void latch();
+    // Oublie la dernière trame verrouillée (le prochain envoi sera complet)
+    void invalidate();
+
+    // Produit la séquence complète : désactivation des sorties (OE haut, si
+    // son masque n'est pas nul), décalage des octets bit de poids faible en
+    // premier (DATA positionnée sur le front descendant de CLK, seulement si
+    // elle change) puis impulsion sur LE. Le vecteur est réutilisé d'un appel
+    // à l'autre.
+    void compile(vector<CGPIOStep>& steps, const Broches& broches) const;
+
+    // Ajoute à 'steps' la séquence de n octets quelconques, au même format
+    // que compile(), pour enchainer plusieurs envois dans une seule séquence
+    static void append(vector<CGPIOStep>& steps, const uint8_t* octets, size_t n, const Broches& broches);
+
+    // Séquence d'un envoi en parallèle : les afficheurs sont répartis en
+    // nbLignes sous-chaines consécutives de (n + nbLignes - 1) / nbLignes
+    // afficheurs (la dernière, plus courte, reçoit d'abord des octets de
+    // bourrage qui sortent de la chaine). Les octets de même rang des
+    // sous-chaines sont transposés par blocs de 8x8 bits : chaque front de
+    // CLK envoie un bit sur chaque ligne, la séquence est donc nbLignes fois
+    // plus courte qu'avec append()
+    void compileSlices(vector<CGPIOStep>& steps, const BrochesParalleles& broches) const;
+    static void appendSlices(vector<CGPIOStep>& steps, const uint8_t* octets, size_t n,
+                             const BrochesParalleles& broches);
+
+private:
+    vector<uint8_t> trame;
+    vector<uint8_t> latched;
+    bool latchedValid;
+};
+
+#endif	/* TRAMEAFFICHAGE_H */
+
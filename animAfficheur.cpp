@@ -0,0 +1,50 @@
+/*
+ * File:   animAfficheur.cpp
+ * Author: olivier
+ *
+ * Compilation d'un script d'animation (voir AnimationAffichage.h) en un
+ * fichier à lire par PanneauAffichage::play() :
+ *   make anim ANIMFLAGS="8 accueil.txt accueil.anim"
+ * Avec --dphaut, les trames sont encodées pour des afficheurs montés point
+ * décimal en haut.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "AnimationAffichage.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    Orientation orientation = Orientation::DPBas;
+    int i = 1;
+    if (i < argc && string(argv[i]) == "--dphaut") {
+        orientation = Orientation::DPHaut;
+        i++;
+    }
+    if (argc - i != 3 || atoi(argv[i]) < 1) {
+        cerr << "Usage : " << argv[0] << " [--dphaut] nbAfficheurs script animation" << endl;
+        return 1;
+    }
+
+    ifstream script(argv[i + 1]);
+    if (!script) {
+        cerr << "Impossible d'ouvrir " << argv[i + 1] << endl;
+        return 1;
+    }
+    string erreur;
+    if (!AnimationAffichage::compile(script, atoi(argv[i]), orientation, argv[i + 2], erreur)) {
+        cerr << argv[i + 1] << " : " << erreur << endl;
+        return 1;
+    }
+
+    AnimationAffichage animation;
+    if (!animation.open(argv[i + 2], erreur)) {
+        cerr << erreur << endl;
+        return 1;
+    }
+    cout << animation.size() << " étapes, " << animation.getDuree() << " ms" << endl;
+    return 0;
+}
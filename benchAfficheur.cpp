@@ -0,0 +1,370 @@
+/*
+ * File:   benchAfficheur.cpp
+ * Author: olivier
+ *
+ * Banc de mesure des chemins critiques, sans matériel :
+ * - basculements/s de CGPIO::fixHigh()/fixLow() ;
+ * - octets/s décalés dans la chaine de registres (trame complète, nombre
+ *   d'octets par seconde) ;
+ * - trames/s de displayNumber() pour plusieurs nombres d'afficheurs.
+ * Chaque mesure est faite pour chaque méthode d'accés :
+ * - sysfs : arborescence factice (export, gpioN/direction, gpioN/value)
+ *   créée sur un tmpfs (/dev/shm par défaut) ;
+ * - mmap : registres simulés par un fichier anonyme (memfd) ;
+ * - cdev : seulement si une puce est indiquée (--cdev=/dev/gpiochipN) ;
+ * - mmap-4lignes : mmap avec 4 lignes DATA en parallèle (voir
+ *   TrameAffichage::appendSlices) ;
+ * - mmap-statique : mmap avec un PanneauStatique (câblage fixé à la
+ *   compilation, octets/s seulement) ;
+ * - capture : décalage confié à un CCaptureTransport (coût processeur
+ *   seul, pour les trames) ;
+ * - sim : chaine de registres simulée (CGPIOSimBackend), qui ajoute pour
+ *   displayNumber() les changements d'état des broches et les violations
+ *   de temps de la chaine, mesurés sur la même durée que les trames (le
+ *   rapport des deux débits donne le coût d'une trame). Le contenu des
+ *   afficheurs simulés est aussi comparé à la dernière trame envoyée ;
+ * - sim-4lignes : la même simulation avec 4 lignes DATA, chacune reliée à
+ *   sa propre sous-chaine de registres.
+ *
+ * Avec --instrumentation, les mesures sont faites avec l'instrumentation
+ * activée (voir Instrumentation.h) pour en évaluer le coût. De même avec
+ * --enregistrement=fichier, les changements d'état des broches sont
+ * enregistrés pendant les mesures (voir EnregistreurBroches.h).
+ *
+ * Résultats sur la sortie standard en CSV (par défaut) ou JSON, une ligne
+ * ou un objet par mesure, pour suivre les régressions d'une version à
+ * l'autre :
+ *   make bench BENCHFLAGS="--format=json --duree=500"
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PanneauAffichage.h"
+#include "PanneauStatique.h"
+#include "GPIOSysfsBackend.h"
+#include "GPIOMmapBackend.h"
+#include "GPIOCdevBackend.h"
+#include "GPIOSimBackend.h"
+#include "Instrumentation.h"
+#include "EnregistreurBroches.h"
+
+using namespace std;
+
+// Broches du panneau mesuré (câblage de testAfficheur)
+static const int pinOE = 18, pinLE = 22, pinData = 10, pinClk = 11;
+static const int nbAfficheursMesures[] = {1, 2, 4, 8, 16, 32};
+// Lignes DATA des mesures en parallèle
+static const vector<int> pinsDataParalleles = {pinData, 9, 8, 7};
+
+struct Options {
+    string format = "csv";
+    string racine = "/dev/shm";
+    string cdev;
+    int dureeMs = 300;
+    bool instrumentation = false;
+    string enregistrement;
+};
+
+struct Resultat {
+    string mesure;
+    string backend;
+    int nbAfficheurs;
+    uint64_t operations;
+    double secondes;
+    string unite;
+};
+
+static vector<Resultat> resultats;
+// Faux si le contenu d'un panneau simulé ne correspond pas à la trame envoyée
+static bool conforme = true;
+
+// Répète 'operation' pendant la durée demandée (par paquets, pour ne pas
+// mesurer l'horloge) et enregistre le débit
+template<typename F>
+static void mesurer(const Options& options, const string& mesure, const string& backend, int nbAfficheurs,
+                    const string& unite, uint64_t parOperation, F operation) {
+    typedef std::chrono::steady_clock horloge;
+    auto fin = horloge::now() + std::chrono::milliseconds(options.dureeMs);
+    auto debut = horloge::now();
+    uint64_t n = 0;
+    horloge::time_point maintenant;
+    do {
+        for (int i=0; i<64; i++)
+            operation(n++);
+        maintenant = horloge::now();
+    } while (maintenant < fin);
+    double secondes = std::chrono::duration<double>(maintenant - debut).count();
+    resultats.push_back({mesure, backend, nbAfficheurs, n * parOperation, secondes, unite});
+}
+
+// Arborescence /sys/class/gpio factice : les fichiers sont des fichiers
+// ordinaires sur un tmpfs, les écritures coûtent donc un appel système
+// comme avec le vrai sysfs (sans le pilote)
+static string creerSysfs(const Options& options) {
+    string modele = options.racine + "/benchAfficheur.XXXXXX";
+    vector<char> chemin(modele.begin(), modele.end());
+    chemin.push_back('\0');
+    if (mkdtemp(chemin.data()) == nullptr) {
+        cerr << "Impossible de créer " << modele << " : " << strerror(errno) << endl;
+        return "";
+    }
+    string racine(chemin.data());
+    for (const char* nom : {"/export", "/unexport"})
+        ::close(::open((racine + nom).c_str(), O_WRONLY | O_CREAT, 0644));
+    for (int pin : {pinOE, pinLE, pinData, pinClk}) {
+        string gpio = racine + "/gpio" + to_string(pin);
+        mkdir(gpio.c_str(), 0755);
+        for (const char* nom : {"/direction", "/value"})
+            ::close(::open((gpio + nom).c_str(), O_WRONLY | O_CREAT, 0644));
+    }
+    return racine;
+}
+
+static void supprimerSysfs(const string& racine) {
+    for (int pin : {pinOE, pinLE, pinData, pinClk}) {
+        string gpio = racine + "/gpio" + to_string(pin);
+        unlink((gpio + "/direction").c_str());
+        unlink((gpio + "/value").c_str());
+        rmdir(gpio.c_str());
+    }
+    unlink((racine + "/export").c_str());
+    unlink((racine + "/unexport").c_str());
+    rmdir(racine.c_str());
+}
+
+// Registres BCM283x simulés : une page anonyme suffit
+static int creerRegistres() {
+    int fd = memfd_create("benchAfficheur", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, 4096) != 0) {
+        cerr << "Impossible de créer le fichier de registres : " << strerror(errno) << endl;
+        return -1;
+    }
+    return fd;
+}
+
+static void mesurerBroche(const Options& options, const string& nom, CGPIOBackend* backend) {
+    CGPIO broche(pinClk, CGPIO::CGPIODirection::OUT, CGPIO::CGPIOValue::LOW, backend);
+    if (!broche.init()) {
+        cerr << nom << " : " << broche.getLastError();
+        return;
+    }
+    // Un basculement = fixHigh() + fixLow()
+    mesurer(options, "basculements", nom, 0, "basculements/s", 1, [&](uint64_t) {
+        broche.fixHigh();
+        broche.fixLow();
+    });
+    broche.close();
+}
+
+static void mesurerPanneau(const Options& options, const string& nom, CGPIOBackend* backend,
+                           CShiftTransport* transport, bool paralleles = false) {
+    for (int nbAfficheurs : nbAfficheursMesures) {
+        unique_ptr<PanneauAffichage> panneau;
+        if (transport != nullptr)
+            panneau.reset(new PanneauAffichage(nbAfficheurs, pinOE, pinLE, transport, backend));
+        else if (paralleles)
+            panneau.reset(new PanneauAffichage(nbAfficheurs, pinOE, pinLE, pinsDataParalleles, pinClk, backend));
+        else
+            panneau.reset(new PanneauAffichage(nbAfficheurs, pinOE, pinLE, pinData, pinClk, backend));
+
+        try {
+            panneau->init();
+
+            // Trames toujours différentes : l'envoi n'est jamais évité
+            uint64_t modulo = 1;
+            for (int i=0; i<nbAfficheurs && i<18; i++)
+                modulo *= 10;
+            vector<uint8_t> trame(nbAfficheurs);
+            mesurer(options, "octets", nom, nbAfficheurs, "octets/s", nbAfficheurs, [&](uint64_t n) {
+                trame[0] = n;
+                panneau->displayFrame(trame.data());
+            });
+            mesurer(options, "displayNumber", nom, nbAfficheurs, "trames/s", 1, [&](uint64_t n) {
+                panneau->displayNumber(n % modulo);
+            });
+
+            panneau->close();
+        }
+        catch (PanneauAffichage::Erreur& e) {
+            cerr << nom << " : " << e.what() << endl;
+        }
+    }
+}
+
+template<int N>
+static void mesurerStatique(const Options& options, CGPIOMmapBackend& mmap) {
+    try {
+        PanneauStatique<CGPIOMmapBackend, pinOE, pinLE, pinData, pinClk, N> panneau(mmap);
+        uint8_t trame[N] = {};
+        mesurer(options, "octets", "mmap-statique", N, "octets/s", N, [&](uint64_t n) {
+            trame[0] = n;
+            panneau.displayFrame(trame);
+        });
+    }
+    catch (PanneauAffichage::Erreur& e) {
+        cerr << "mmap-statique : " << e.what() << endl;
+    }
+}
+
+// Mêmes nombres d'afficheurs que nbAfficheursMesures, fixés à la compilation
+template<int... N>
+static void mesurerStatiques(const Options& options, CGPIOMmapBackend& mmap, std::integer_sequence<int, N...>) {
+    (mesurerStatique<N>(options, mmap), ...);
+}
+
+static void mesurerSimulation(const Options& options, const string& nom, bool paralleles = false) {
+    const vector<int> pinsData = paralleles ? pinsDataParalleles : vector<int>{pinData};
+    for (int nbAfficheurs : nbAfficheursMesures) {
+        CGPIOSimBackend sim(nbAfficheurs, pinOE, pinLE, pinsData, pinClk);
+        unique_ptr<PanneauAffichage> panneau;
+        if (paralleles)
+            panneau.reset(new PanneauAffichage(nbAfficheurs, pinOE, pinLE, pinsData, pinClk, &sim));
+        else
+            panneau.reset(new PanneauAffichage(nbAfficheurs, pinOE, pinLE, pinData, pinClk, &sim));
+
+        try {
+            panneau->init();
+
+            uint64_t modulo = 1;
+            for (int i=0; i<nbAfficheurs && i<18; i++)
+                modulo *= 10;
+            sim.resetStats();
+            mesurer(options, "displayNumber", nom, nbAfficheurs, "trames/s", 1, [&](uint64_t n) {
+                panneau->displayNumber(n % modulo);
+            });
+            CGPIOSimStats stats = sim.getStats();
+            double secondes = resultats.back().secondes;
+            resultats.push_back({"transitions", nom, nbAfficheurs, stats.transitions, secondes, "transitions/s"});
+            resultats.push_back({"violations", nom, nbAfficheurs,
+                                 stats.setupViolations + stats.holdViolations + stats.clockViolations,
+                                 secondes, "violations/s"});
+
+            vector<uint8_t> trame(nbAfficheurs);
+            for (int i=0; i<nbAfficheurs; i++)
+                trame[i] = 37 * i + 1;
+            panneau->displayFrame(trame.data());
+            for (int i=0; i<nbAfficheurs; i++) {
+                if (sim.getSegments(i) != trame[i]) {
+                    cerr << nom << " : afficheur " << i << "/" << nbAfficheurs << " : " << (int)sim.getSegments(i)
+                         << " au lieu de " << (int)trame[i] << endl;
+                    conforme = false;
+                    break;
+                }
+            }
+
+            panneau->close();
+        }
+        catch (PanneauAffichage::Erreur& e) {
+            cerr << nom << " : " << e.what() << endl;
+        }
+    }
+}
+
+static void afficher(const Options& options) {
+    if (options.format == "json") {
+        cout << "[" << endl;
+        for (size_t i=0; i<resultats.size(); i++) {
+            const Resultat& r = resultats[i];
+            printf("  {\"mesure\": \"%s\", \"backend\": \"%s\", \"nbAfficheurs\": %d, "
+                   "\"operations\": %llu, \"secondes\": %.6f, \"debit\": %.1f, \"unite\": \"%s\"}%s\n",
+                   r.mesure.c_str(), r.backend.c_str(), r.nbAfficheurs, (unsigned long long)r.operations,
+                   r.secondes, r.operations / r.secondes, r.unite.c_str(),
+                   (i + 1 < resultats.size()) ? "," : "");
+        }
+        cout << "]" << endl;
+    }
+    else {
+        cout << "mesure,backend,nbAfficheurs,operations,secondes,debit,unite" << endl;
+        for (const Resultat& r : resultats)
+            printf("%s,%s,%d,%llu,%.6f,%.1f,%s\n", r.mesure.c_str(), r.backend.c_str(), r.nbAfficheurs,
+                   (unsigned long long)r.operations, r.secondes, r.operations / r.secondes, r.unite.c_str());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i=1; i<argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--format=") == 0)
+            options.format = arg.substr(9);
+        else if (arg.compare(0, 9, "--racine=") == 0)
+            options.racine = arg.substr(9);
+        else if (arg.compare(0, 7, "--cdev=") == 0)
+            options.cdev = arg.substr(7);
+        else if (arg.compare(0, 8, "--duree=") == 0)
+            options.dureeMs = atoi(arg.substr(8).c_str());
+        else if (arg == "--instrumentation")
+            options.instrumentation = true;
+        else if (arg.compare(0, 17, "--enregistrement=") == 0)
+            options.enregistrement = arg.substr(17);
+        else {
+            cerr << "Usage : " << argv[0] << " [--format=csv|json] [--duree=ms] [--racine=tmpfs]"
+                 << " [--cdev=/dev/gpiochipN] [--instrumentation] [--enregistrement=fichier]" << endl;
+            return 1;
+        }
+    }
+
+    Instrumentation::enable(options.instrumentation);
+    if (!options.enregistrement.empty()) {
+        string erreur;
+        if (!EnregistreurBroches::start(options.enregistrement, 64 << 20, std::chrono::milliseconds(20), erreur)) {
+            cerr << erreur << endl;
+            return 1;
+        }
+    }
+
+    string racine = creerSysfs(options);
+    if (!racine.empty()) {
+        CGPIOSysfsBackend sysfs(racine);
+        mesurerBroche(options, "sysfs", &sysfs);
+        mesurerPanneau(options, "sysfs", &sysfs, nullptr);
+        supprimerSysfs(racine);
+    }
+
+    int registres = creerRegistres();
+    if (registres >= 0) {
+        CGPIOMmapBackend mmap(registres);
+        ::close(registres);
+        mesurerBroche(options, "mmap", &mmap);
+        mesurerPanneau(options, "mmap", &mmap, nullptr);
+        mesurerPanneau(options, "mmap-4lignes", &mmap, nullptr, true);
+        mesurerStatiques(options, mmap, std::integer_sequence<int, 1, 2, 4, 8, 16, 32>());
+    }
+
+    if (!options.cdev.empty()) {
+        CGPIOCdevBackend cdev(options.cdev);
+        mesurerBroche(options, "cdev", &cdev);
+        mesurerPanneau(options, "cdev", &cdev, nullptr);
+    }
+
+    // Décalage seul, sans broche réelle pour LE et OE
+    if (registres >= 0) {
+        int fd = creerRegistres();
+        CGPIOMmapBackend mmap(fd);
+        ::close(fd);
+        CCaptureTransport capture;
+        mesurerPanneau(options, "capture", &mmap, &capture);
+    }
+
+    mesurerSimulation(options, "sim");
+    mesurerSimulation(options, "sim-4lignes", true);
+    if (!options.enregistrement.empty()) {
+        EnregistreurBroches::stop();
+        cerr << EnregistreurBroches::getDropped() << " changements non enregistrés" << endl;
+    }
+
+    afficher(options);
+    return conforme ? 0 : 2;
+}
@@ -0,0 +1,151 @@
+/*
+ * File:   demonAfficheur.cpp
+ * Author: olivier
+ *
+ * Démon d'affichage : initialise les panneaux décrits sur la ligne de
+ * commande, publie le tampon partagé (voir DemonAffichage) puis attend
+ * SIGINT ou SIGTERM pour tout libérer. Par exemple, pour deux panneaux
+ * (nbAfficheurs,OE,LE,DATA,CLK) :
+ *   make demon DEMONFLAGS="--panneau=2,18,22,10,11 --panneau=4,23,24,25,8"
+ *
+ * Chaque panneau est piloté séparément : deux panneaux ne peuvent pas
+ * partager une broche (des panneaux sur un bus DATA/CLK commun se pilotent
+ * avec ControleurPanneaux).
+ *
+ * Le tampon n'est accessible qu'aux membres du groupe du démon, ou de
+ * celui indiqué par --groupe=nom.
+ *
+ * Un client écrit ensuite ses trames sans passer par le démon :
+ *   auto tampon = TamponAffichage::open("/afficheur7seg");
+ *   tampon->write(0, octets);
+ *
+ * Avec --enregistrement=fichier[,Mio], les changements d'état des broches
+ * sont enregistrés en continu (voir EnregistreurBroches, 16 Mio par
+ * défaut), à convertir en VCD par vcdAfficheur.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <csignal>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "DemonAffichage.h"
+#include "EnregistreurBroches.h"
+
+using namespace std;
+
+static volatile sig_atomic_t arret = 0;
+
+static void signalArret(int) {
+    arret = 1;
+}
+
+int main(int argc, char* argv[]) {
+    string nom = "/afficheur7seg";
+    string groupe;
+    int periodeMs = 10;
+    string enregistrement;
+    int tailleEnregistrement = 16;
+    vector<unique_ptr<PanneauAffichage>> panneaux;
+    set<int> broches;
+
+    for (int i=1; i<argc; i++) {
+        string arg = argv[i];
+        int nb, oe, le, data, clk;
+        if (arg.compare(0, 6, "--nom=") == 0)
+            nom = arg.substr(6);
+        else if (arg.compare(0, 9, "--groupe=") == 0)
+            groupe = arg.substr(9);
+        else if (arg.compare(0, 10, "--periode=") == 0)
+            periodeMs = atoi(arg.substr(10).c_str());
+        else if (arg.compare(0, 17, "--enregistrement=") == 0) {
+            enregistrement = arg.substr(17);
+            size_t virgule = enregistrement.find(',');
+            if (virgule != string::npos) {
+                tailleEnregistrement = atoi(enregistrement.substr(virgule + 1).c_str());
+                enregistrement.resize(virgule);
+            }
+        }
+        else if (arg.compare(0, 10, "--panneau=") == 0 &&
+                 sscanf(arg.c_str() + 10, "%d,%d,%d,%d,%d", &nb, &oe, &le, &data, &clk) == 5) {
+            // Une broche déjà réservée par un autre panneau serait refusée
+            // (cdev) ou libérée à sa place (sysfs)
+            for (int pin : {oe, le, data, clk}) {
+                if (!broches.insert(pin).second) {
+                    cerr << "La broche " << pin << " est utilisée par deux panneaux" << endl;
+                    return 1;
+                }
+            }
+            panneaux.emplace_back(new PanneauAffichage(nb, oe, le, data, clk));
+        }
+        else {
+            cerr << "Usage : " << argv[0] << " [--nom=/afficheur7seg] [--groupe=nom] [--periode=ms] [--enregistrement=fichier[,Mio]]"
+                 << " --panneau=nbAfficheurs,OE,LE,DATA,CLK..." << endl;
+            return 1;
+        }
+    }
+    if (panneaux.empty()) {
+        cerr << "Aucun panneau à piloter" << endl;
+        return 1;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = signalArret;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    if (!enregistrement.empty()) {
+        string erreur;
+        if (!EnregistreurBroches::start(enregistrement, (size_t)tailleEnregistrement << 20,
+                                        std::chrono::milliseconds(100), erreur)) {
+            cerr << erreur << endl;
+            return 1;
+        }
+    }
+
+    DemonAffichage demon(nom, std::chrono::milliseconds(periodeMs), groupe);
+    try {
+        for (auto& panneau : panneaux) {
+            panneau->init();
+            panneau->setBrightness(MoteurLuminosite::luminositeMax);
+            demon.addPanel(panneau.get());
+        }
+        demon.start();
+    }
+    catch (PanneauAffichage::Erreur& e) {
+        cerr << e.what() << endl;
+        // Les panneaux déjà initialisés sont refermés (close() est sans
+        // effet sur les autres) et l'enregistrement est terminé
+        demon.stop();
+        for (auto& panneau : panneaux) {
+            try {
+                panneau->close();
+            }
+            catch (PanneauAffichage::Erreur& e) {
+                cerr << e.what() << endl;
+            }
+        }
+        EnregistreurBroches::stop();
+        return 1;
+    }
+
+    while (!arret)
+        pause();
+
+    demon.stop();
+    cout << demon.getFramesSent() << " trames envoyées" << endl;
+    for (auto& panneau : panneaux) {
+        try {
+            panneau->close();
+        }
+        catch (PanneauAffichage::Erreur& e) {
+            cerr << e.what() << endl;
+        }
+    }
+    EnregistreurBroches::stop();
+    return 0;
+}
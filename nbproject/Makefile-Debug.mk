@@ -35,8 +35,27 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/AnimationAffichage.o \
+	${OBJECTDIR}/BalayageAffichage.o \
+	${OBJECTDIR}/ControleurPanneaux.o \
+	${OBJECTDIR}/DemonAffichage.o \
+	${OBJECTDIR}/EnregistreurBroches.o \
+	${OBJECTDIR}/FileAffichage.o \
+	${OBJECTDIR}/GPIOCdevBackend.o \
 	${OBJECTDIR}/GPIOClass.o \
+	${OBJECTDIR}/GPIOEventLoop.o \
+	${OBJECTDIR}/GPIOMmapBackend.o \
+	${OBJECTDIR}/GPIOPort.o \
+	${OBJECTDIR}/GPIOSimBackend.o \
+	${OBJECTDIR}/GPIOSysfsBackend.o \
+	${OBJECTDIR}/Instrumentation.o \
+	${OBJECTDIR}/MoteurLuminosite.o \
+	${OBJECTDIR}/OrdonnanceurAffichage.o \
+	${OBJECTDIR}/PWMSysfs.o \
 	${OBJECTDIR}/PanneauAffichage.o \
+	${OBJECTDIR}/SPITransport.o \
+	${OBJECTDIR}/TamponAffichage.o \
+	${OBJECTDIR}/TrameAffichage.o \
 	${OBJECTDIR}/testAfficheur.o
 
 
@@ -44,8 +63,8 @@ OBJECTFILES= \
 CFLAGS=
 
 # CC Compiler Flags
-CCFLAGS=-std=c++0x
-CXXFLAGS=-std=c++0x
+CCFLAGS=-std=c++20
+CXXFLAGS=-std=c++20
 
 # Fortran Compiler Flags
 FFLAGS=
@@ -54,7 +73,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=
+LDLIBSOPTIONS=-lpthread
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -64,16 +83,111 @@ ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/afficheur7seg: ${OBJECTFILES}
 	${MKDIR} -p ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}
 	${LINK.cc} -o ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/afficheur7seg ${OBJECTFILES} ${LDLIBSOPTIONS}
 
+${OBJECTDIR}/AnimationAffichage.o: AnimationAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/AnimationAffichage.o AnimationAffichage.cpp
+
+${OBJECTDIR}/BalayageAffichage.o: BalayageAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/BalayageAffichage.o BalayageAffichage.cpp
+
+${OBJECTDIR}/ControleurPanneaux.o: ControleurPanneaux.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ControleurPanneaux.o ControleurPanneaux.cpp
+
+${OBJECTDIR}/DemonAffichage.o: DemonAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/DemonAffichage.o DemonAffichage.cpp
+
+${OBJECTDIR}/EnregistreurBroches.o: EnregistreurBroches.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/EnregistreurBroches.o EnregistreurBroches.cpp
+
+${OBJECTDIR}/FileAffichage.o: FileAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FileAffichage.o FileAffichage.cpp
+
+${OBJECTDIR}/GPIOCdevBackend.o: GPIOCdevBackend.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOCdevBackend.o GPIOCdevBackend.cpp
+
 ${OBJECTDIR}/GPIOClass.o: GPIOClass.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOClass.o GPIOClass.cpp
 
+${OBJECTDIR}/GPIOEventLoop.o: GPIOEventLoop.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOEventLoop.o GPIOEventLoop.cpp
+
+${OBJECTDIR}/GPIOMmapBackend.o: GPIOMmapBackend.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOMmapBackend.o GPIOMmapBackend.cpp
+
+${OBJECTDIR}/GPIOPort.o: GPIOPort.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOPort.o GPIOPort.cpp
+
+${OBJECTDIR}/GPIOSimBackend.o: GPIOSimBackend.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOSimBackend.o GPIOSimBackend.cpp
+
+${OBJECTDIR}/GPIOSysfsBackend.o: GPIOSysfsBackend.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/GPIOSysfsBackend.o GPIOSysfsBackend.cpp
+
+${OBJECTDIR}/Instrumentation.o: Instrumentation.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Instrumentation.o Instrumentation.cpp
+
+${OBJECTDIR}/MoteurLuminosite.o: MoteurLuminosite.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MoteurLuminosite.o MoteurLuminosite.cpp
+
+${OBJECTDIR}/OrdonnanceurAffichage.o: OrdonnanceurAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OrdonnanceurAffichage.o OrdonnanceurAffichage.cpp
+
+${OBJECTDIR}/PWMSysfs.o: PWMSysfs.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PWMSysfs.o PWMSysfs.cpp
+
 ${OBJECTDIR}/PanneauAffichage.o: PanneauAffichage.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PanneauAffichage.o PanneauAffichage.cpp
 
+${OBJECTDIR}/SPITransport.o: SPITransport.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SPITransport.o SPITransport.cpp
+
+${OBJECTDIR}/TamponAffichage.o: TamponAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TamponAffichage.o TamponAffichage.cpp
+
+${OBJECTDIR}/TrameAffichage.o: TrameAffichage.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -s -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TrameAffichage.o TrameAffichage.cpp
+
 ${OBJECTDIR}/testAfficheur.o: testAfficheur.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
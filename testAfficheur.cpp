@@ -1,11 +1,21 @@
 #include <iostream>
 #include <cstdint>
 #include <vector>
+#include <unistd.h>
 
 #include "PanneauAffichage.h"
 
 using namespace std;
 
+// Date et heure toutes les 5 secondes, sans bloquer le thread : d'autres
+// panneaux pourraient être animés par le même ordonnanceur
+Tache horodatage(PanneauAffichage& panneau) {
+        for (int i=0; i<10; i++) {
+                co_await panneau.showDateTime();
+                co_await after(std::chrono::seconds(5));
+        }
+}
+
 int main() {
         // Constructeur du panneau, les arguments dans l'ordre sont
         // Nb d'afficheurs du panneau
@@ -34,9 +44,13 @@ int main() {
         monPanneau.fadeIn();
         monPanneau.fadeOut();
         
-        for (int i=0; i<10; i++) {
-                monPanneau.displayDateTime();
-                sleep(5);
+        OrdonnanceurAffichage ordonnanceur;
+        ordonnanceur.spawn(horodatage(monPanneau));
+        try {
+                ordonnanceur.run();
+        }
+        catch (PanneauAffichage::Erreur& e) {
+            cerr << e.what() << endl;
         }
         
         try {
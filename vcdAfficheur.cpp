@@ -0,0 +1,44 @@
+/*
+ * File:   vcdAfficheur.cpp
+ * Author: olivier
+ *
+ * Conversion d'un fichier d'enregistrement des broches (voir
+ * EnregistreurBroches) au format VCD, pour l'ouvrir dans GTKWave :
+ *   make vcd VCDFLAGS="/var/tmp/afficheur.enr afficheur.vcd"
+ *   gtkwave afficheur.vcd
+ * Sans fichier de sortie, le VCD est écrit sur la sortie standard.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "EnregistreurBroches.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage : " << argv[0] << " enregistrement [sortie.vcd]" << endl;
+        return 1;
+    }
+
+    string erreur;
+    bool ok;
+    if (argc == 3) {
+        ofstream sortie(argv[2]);
+        if (!sortie) {
+            cerr << "Impossible de créer " << argv[2] << endl;
+            return 1;
+        }
+        ok = EnregistreurBroches::exportVCD(argv[1], sortie, erreur);
+    }
+    else
+        ok = EnregistreurBroches::exportVCD(argv[1], cout, erreur);
+
+    if (!ok) {
+        cerr << erreur << endl;
+        return 1;
+    }
+    return 0;
+}